@@ -7,9 +7,11 @@
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <cassert>
 #include <functional>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include "alloc.h"
 #include "async.h"
@@ -21,6 +23,37 @@
 namespace FASTER {
 namespace core {
 
+/// Point-in-time copy of the reclamation counters of a LightEpoch. Reading it never blocks
+/// threads that protect, bump or drain the epoch.
+struct EpochTelemetry {
+  /// Bucket b of the latency histogram counts retire-to-reclaim latencies in [2^b, 2^(b+1)) ns.
+  static constexpr uint32_t kLatencyBuckets = 64;
+
+  uint64_t current_epoch;
+  uint64_t safe_to_reclaim_epoch;
+  /// current_epoch - safe_to_reclaim_epoch, how far reclamation trails the writers.
+  uint64_t reclaim_lag;
+  /// Largest lag seen by any ComputeNewSafeToReclaimEpoch() call.
+  uint64_t max_reclaim_lag;
+  /// Trigger actions waiting in the drain list, out of drain_list_capacity.
+  uint32_t pending_drain_actions;
+  uint32_t drain_list_capacity;
+  /// Trigger actions registered and executed since construction.
+  uint64_t retired;
+  uint64_t reclaimed;
+  uint64_t reclaim_latency_sum_ns;
+  uint64_t reclaim_latency_max_ns;
+  uint64_t reclaim_latency_histogram[kLatencyBuckets];
+  /// Times BumpCurrentEpoch() found no free drain-list slot for 500 passes and slept.
+  uint64_t slowdown_events;
+  /// Drain() calls made by each thread, indexed by Thread::id().
+  std::vector<uint64_t> drain_calls_per_thread;
+
+  double MeanReclaimLatencyNs() const {
+    return reclaimed ? static_cast<double>(reclaim_latency_sum_ns) / reclaimed : 0.0;
+  }
+};
+
 class LightEpoch {
  private:
   /// Entry in epoch table
@@ -28,12 +61,15 @@ class LightEpoch {
     Entry()
       : local_current_epoch{ 0 }
       , reentrant{ 0 }
-      , phase_finished{ Phase::REST } {
+      , phase_finished{ Phase::REST }
+      , drain_calls{ 0 } {
     }
 
     uint64_t local_current_epoch;
     uint32_t reentrant;
     std::atomic<Phase> phase_finished;
+    /// Written only by the owning thread, read by Telemetry().
+    std::atomic<uint64_t> drain_calls;
   };
   static_assert(sizeof(Entry) == 64, "sizeof(Entry) != 64");
 
@@ -52,6 +88,7 @@ class LightEpoch {
     void Initialize() {
       callback = nullptr;
       context = nullptr;
+      retire_ns = 0;
       epoch = kFree;
     }
 
@@ -59,11 +96,12 @@ class LightEpoch {
       return epoch.load() == kFree;
     }
 
-    bool TryPop(uint64_t expected_epoch) {
+    bool TryPop(uint64_t expected_epoch, uint64_t& popped_retire_ns) {
       bool retval = epoch.compare_exchange_strong(expected_epoch, kLocked);
       if(retval) {
         callback_t callback_ = callback;
         IAsyncContext* context_ = context;
+        popped_retire_ns = retire_ns;
         callback = nullptr;
         context = nullptr;
         // Release the lock.
@@ -74,12 +112,14 @@ class LightEpoch {
       return retval;
     }
 
-    bool TryPush(uint64_t prior_epoch, callback_t new_callback, IAsyncContext* new_context) {
+    bool TryPush(uint64_t prior_epoch, callback_t new_callback, IAsyncContext* new_context,
+                 uint64_t new_retire_ns) {
       uint64_t expected_epoch = kFree;
       bool retval = epoch.compare_exchange_strong(expected_epoch, kLocked);
       if(retval) {
         callback = new_callback;
         context = new_context;
+        retire_ns = new_retire_ns;
         // Release the lock.
         epoch.store(prior_epoch);
       }
@@ -87,13 +127,15 @@ class LightEpoch {
     }
 
     bool TrySwap(uint64_t expected_epoch, uint64_t prior_epoch, callback_t new_callback,
-                 IAsyncContext* new_context) {
+                 IAsyncContext* new_context, uint64_t new_retire_ns, uint64_t& existing_retire_ns) {
       bool retval = epoch.compare_exchange_strong(expected_epoch, kLocked);
       if(retval) {
         callback_t existing_callback = callback;
         IAsyncContext* existing_context = context;
+        existing_retire_ns = retire_ns;
         callback = new_callback;
         context = new_context;
+        retire_ns = new_retire_ns;
         // Release the lock.
         epoch.store(prior_epoch);
         // Perform the action.
@@ -107,6 +149,8 @@ class LightEpoch {
 
     void(*callback)(IAsyncContext* context);
     IAsyncContext* context;
+    /// Steady-clock time the action was registered, guarded by the epoch lock like callback.
+    uint64_t retire_ns;
   };
 
  public:
@@ -131,6 +175,15 @@ class LightEpoch {
   /// Count of drain actions
   std::atomic<uint32_t> drain_count_;
 
+  /// Telemetry, see EpochTelemetry.
+  std::atomic<uint64_t> retired_count_;
+  std::atomic<uint64_t> reclaimed_count_;
+  std::atomic<uint64_t> reclaim_latency_sum_ns_;
+  std::atomic<uint64_t> reclaim_latency_max_ns_;
+  std::atomic<uint64_t> reclaim_latency_histogram_[EpochTelemetry::kLatencyBuckets];
+  std::atomic<uint64_t> max_reclaim_lag_;
+  std::atomic<uint64_t> slowdown_count_;
+
  public:
   /// Current system epoch (global state)
   std::atomic<uint64_t> current_epoch;
@@ -162,6 +215,37 @@ class LightEpoch {
       drain_list_[idx].Initialize();
     }
     drain_count_ = 0;
+    retired_count_ = 0;
+    reclaimed_count_ = 0;
+    reclaim_latency_sum_ns_ = 0;
+    reclaim_latency_max_ns_ = 0;
+    for(auto& bucket : reclaim_latency_histogram_) {
+      bucket = 0;
+    }
+    max_reclaim_lag_ = 0;
+    slowdown_count_ = 0;
+  }
+
+  static inline uint64_t NowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  static inline void StoreMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t prev = target.load(std::memory_order_relaxed);
+    while(prev < value &&
+          !target.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  /// Account for one executed trigger action that was registered at retire_ns.
+  void RecordReclaim(uint64_t retire_ns) {
+    uint64_t latency = NowNs() - retire_ns;
+    uint32_t bucket = latency ? 63 - static_cast<uint32_t>(__builtin_clzll(latency)) : 0;
+    reclaimed_count_.fetch_add(1, std::memory_order_relaxed);
+    reclaim_latency_sum_ns_.fetch_add(latency, std::memory_order_relaxed);
+    reclaim_latency_histogram_[bucket].fetch_add(1, std::memory_order_relaxed);
+    StoreMax(reclaim_latency_max_ns_, latency);
   }
 
   void Uninitialize() {
@@ -191,12 +275,12 @@ class LightEpoch {
     return table_[entry].local_current_epoch;
   }
 
+  /// Calls nest: only the outermost one loads the epoch, and the thread stays
+  /// protected until the matching outermost ReentrantUnprotect().
   uint64_t ReentrantProtect() {
     uint32_t entry = Thread::id();
-    if(table_[entry].local_current_epoch != kUnprotected)
-      return table_[entry].local_current_epoch;
-    table_[entry].local_current_epoch = current_epoch.load();
-    table_[entry].reentrant++;
+    if(table_[entry].reentrant++ == 0)
+      table_[entry].local_current_epoch = current_epoch.load();
     return table_[entry].local_current_epoch;
   }
 
@@ -212,17 +296,22 @@ class LightEpoch {
 
   void ReentrantUnprotect() {
     uint32_t entry = Thread::id();
+    assert(table_[entry].reentrant > 0);
     if(--(table_[entry].reentrant) == 0) {
       table_[entry].local_current_epoch = kUnprotected;
     }
   }
 
   void Drain(uint64_t nextEpoch) {
+    std::atomic<uint64_t>& drain_calls = table_[Thread::id()].drain_calls;
+    drain_calls.store(drain_calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     ComputeNewSafeToReclaimEpoch(nextEpoch);
     for(uint32_t idx = 0; idx < kDrainListSize; ++idx) {
       uint64_t trigger_epoch = drain_list_[idx].epoch.load();
       if(trigger_epoch <= safe_to_reclaim_epoch) {
-        if(drain_list_[idx].TryPop(trigger_epoch)) {
+        uint64_t retire_ns;
+        if(drain_list_[idx].TryPop(trigger_epoch, retire_ns)) {
+          RecordReclaim(retire_ns);
           if(--drain_count_ == 0) {
             break;
           }
@@ -245,26 +334,32 @@ class LightEpoch {
   uint64_t BumpCurrentEpoch(EpochAction::callback_t callback, IAsyncContext* context) {
     uint64_t prior_epoch = BumpCurrentEpoch() - 1;
     uint32_t i = 0, j = 0;
-    uint32_t entry = Thread::id();
-    uint64_t curr_epoch = table_[entry].local_current_epoch;
+    uint64_t retire_ns = NowNs();
+    retired_count_.fetch_add(1, std::memory_order_relaxed);
     while(true) {
       uint64_t trigger_epoch = drain_list_[i].epoch.load();
       if(trigger_epoch == EpochAction::kFree) {
-        if(drain_list_[i].TryPush(prior_epoch, callback, context)) {
+        if(drain_list_[i].TryPush(prior_epoch, callback, context, retire_ns)) {
           ++drain_count_;
           break;
         }
       } else if(trigger_epoch <= safe_to_reclaim_epoch.load()) {
-        if(drain_list_[i].TrySwap(trigger_epoch, prior_epoch, callback, context)) {
+        uint64_t swapped_retire_ns;
+        if(drain_list_[i].TrySwap(trigger_epoch, prior_epoch, callback, context, retire_ns,
+                                  swapped_retire_ns)) {
+          RecordReclaim(swapped_retire_ns);
           break;
         }
       }
       if(++i == kDrainListSize) {
         i = 0;
+        // Other threads may have left their epochs since the last Drain(); without a refresh
+        // every bumping thread could spin on the same stale safe_to_reclaim_epoch.
+        ComputeNewSafeToReclaimEpoch(current_epoch.load());
         if(++j == 500) {
           j = 0;
+          slowdown_count_.fetch_add(1, std::memory_order_relaxed);
           std::this_thread::sleep_for(std::chrono::seconds(1));
-          fprintf(stderr, "Slowdown: Unable to add trigger to epoch\n");
         }
       }
     }
@@ -281,6 +376,7 @@ class LightEpoch {
       }
     }
     safe_to_reclaim_epoch = oldest_ongoing_call - 1;
+    StoreMax(max_reclaim_lag_, current_epoch_ - (oldest_ongoing_call - 1));
     return safe_to_reclaim_epoch;
   }
 
@@ -294,6 +390,37 @@ class LightEpoch {
     return (epoch <= safe_to_reclaim_epoch);
   }
 
+  /// Number of trigger actions in the drain list that have not run yet.
+  uint32_t PendingDrainCount() const {
+    return drain_count_.load();
+  }
+
+  /// Copy the reclamation counters; safe to call from any thread at any time.
+  EpochTelemetry Telemetry() const {
+    EpochTelemetry ret;
+    ret.current_epoch = current_epoch.load();
+    ret.safe_to_reclaim_epoch = safe_to_reclaim_epoch.load();
+    ret.reclaim_lag = ret.current_epoch > ret.safe_to_reclaim_epoch ?
+                      ret.current_epoch - ret.safe_to_reclaim_epoch : 0;
+    ret.max_reclaim_lag = max_reclaim_lag_.load(std::memory_order_relaxed);
+    ret.pending_drain_actions = drain_count_.load();
+    ret.drain_list_capacity = kDrainListSize;
+    ret.retired = retired_count_.load(std::memory_order_relaxed);
+    ret.reclaimed = reclaimed_count_.load(std::memory_order_relaxed);
+    ret.reclaim_latency_sum_ns = reclaim_latency_sum_ns_.load(std::memory_order_relaxed);
+    ret.reclaim_latency_max_ns = reclaim_latency_max_ns_.load(std::memory_order_relaxed);
+    for(uint32_t idx = 0; idx < EpochTelemetry::kLatencyBuckets; ++idx) {
+      ret.reclaim_latency_histogram[idx] = reclaim_latency_histogram_[idx].load(
+                                             std::memory_order_relaxed);
+    }
+    ret.slowdown_events = slowdown_count_.load(std::memory_order_relaxed);
+    ret.drain_calls_per_thread.resize(num_entries_ + 2);
+    for(uint32_t idx = 0; idx < num_entries_ + 2; ++idx) {
+      ret.drain_calls_per_thread[idx] = table_[idx].drain_calls.load(std::memory_order_relaxed);
+    }
+    return ret;
+  }
+
   /// CPR checkpoint functions.
   inline void ResetPhaseFinished() {
     for(uint32_t idx = 1; idx <= num_entries_; ++idx) {
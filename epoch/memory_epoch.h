@@ -58,6 +58,16 @@ public:
         inner_epoch_.ReentrantUnprotect();
     }
 
+    /// Retired pointers whose delete callback has not run yet.
+    inline size_t PendingReclaimCount() const {
+        return inner_epoch_.PendingDrainCount();
+    }
+
+    /// Reclamation counters and gauges, readable while other threads run.
+    FASTER::core::EpochTelemetry Telemetry() const {
+        return inner_epoch_.Telemetry();
+    }
+
     uint64_t BumpEpoch(T *ptr, Pool &pool) {
         Delete_Context<T, Pool> context(ptr, &pool);
         FASTER::core::IAsyncContext *context_copy;
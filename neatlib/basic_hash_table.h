@@ -7,30 +7,78 @@
 
 #include <cassert>
 #include <memory>
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <array>
-#include <stack>
 #include <cmath>
+#include <exception>
 #include <limits>
 #include <stdexcept>
+#include <thread>
 #include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <string>
+#include <vector>
 #include "util.h"
+#include "hash_policy.h"
+#include "slab_pool.h"
+#include "trie_snapshot.h"
+#include "trie_stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NEATLIB_BASIC_HASH_TABLE_SSE2 1
+#endif
 
 namespace neatlib {
 
 template<class Key, class T, class Hash = std::hash<Key>,
         class KeyEqual = std::equal_to<Key>,
         class Allocator = std::allocator<std::pair<const Key, T>>,
-        std::size_t HASH_LEVEL = DEFAULT_NEATLIB_HASH_LEVEL>
+        std::size_t HASH_LEVEL = DEFAULT_NEATLIB_HASH_LEVEL,
+        std::size_t ROOT_HASH_LEVEL = HASH_LEVEL>
 class BasicHashTable {
 private:
-    using node_type = bool;
+    using node_type = uint8_t;
 
-    constexpr static bool ARRAY_NODE = true;
-    constexpr static bool DATA_NODE = false;
+    constexpr static node_type EMPTY_NODE = 0;
+    constexpr static node_type DATA_NODE = 1;
+    constexpr static node_type ARRAY_NODE = 2;
+    constexpr static node_type BUCKET_NODE = 3;
 
     constexpr static std::size_t ARRAY_SIZE =
             static_cast<const size_t>(HASH_LEVEL > 10 ? 65536 : get_power2<HASH_LEVEL>::value);
+    // The root may be wider than the arrays below it. It is there from the
+    // start and every walk goes through it, so a wide root saves the top
+    // levels of every walk while the sparse levels further down stay narrow.
+    constexpr static std::size_t ROOT_ARRAY_SIZE =
+            static_cast<const std::size_t>(get_power2<ROOT_HASH_LEVEL>::value);
+
+    constexpr static std::size_t HASH_BITS = sizeof(std::size_t) * 8;
+
+    static_assert(ROOT_HASH_LEVEL > 0 && ROOT_HASH_LEVEL < HASH_BITS && HASH_LEVEL > 0,
+                  "every level needs some bits of the hash");
+
+    // The root takes the lowest ROOT_HASH_LEVEL bits of the hash, every
+    // level below the next HASH_LEVEL ones; the deepest level may get fewer.
+    // A walk never goes deeper than MAX_LEVEL arrays, by then every bit of
+    // the hash is used up.
+    constexpr static std::size_t MAX_LEVEL = 1 + (HASH_BITS - ROOT_HASH_LEVEL + HASH_LEVEL - 1) / HASH_LEVEL;
+
+    constexpr static std::size_t level_shift(std::size_t level) {
+        return level == 0 ? 0 : ROOT_HASH_LEVEL + HASH_LEVEL * (level - 1);
+    }
+
+    constexpr static std::size_t level_hash(std::size_t hash, std::size_t level) {
+        return level == 0 ? hash & (ROOT_ARRAY_SIZE - 1) : (hash >> level_shift(level)) & (ARRAY_SIZE - 1);
+    }
 
 public:
     using key_type = Key;
@@ -42,228 +90,1661 @@ public:
     using allocator_type = Allocator;
 
 private:
+    // Small trivially copyable entries (uint64_t -> uint64_t and the like)
+    // are stored in the array slots themselves, everything else in separate
+    // data nodes the slots point to.
+    constexpr static bool INLINE_ENTRIES =
+            std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value &&
+            sizeof(value_type) <= 2 * sizeof(void *);
+
     struct node {
         node_type type_;
 
         node(node_type type) : type_(type) {}
     };
 
+    // The full hash is kept next to the entry, so walks compare it before
+    // calling KeyEqual and splits never hash a stored key again.
     struct data_node : node {
+        std::size_t hash_;
         std::pair<const Key, T> data_;
 
-        data_node(const Key &key, const T &mapped) :
-                node(DATA_NODE), data_(key, mapped) {}
+        template<typename... Args>
+        explicit data_node(std::size_t hash, Args &&... args) :
+                node(DATA_NODE), hash_(hash), data_(std::forward<Args>(args)...) {}
+    };
+
+    // Distinct keys with the same full hash can not be told apart by any
+    // level of the trie, so they share one slot as a chain of bucket nodes.
+    struct bucket_node : node {
+        std::size_t hash_;
+        bucket_node *next_;
+        std::pair<const Key, T> data_;
+
+        template<typename... Args>
+        bucket_node(std::size_t hash, bucket_node *next, Args &&... args) :
+                node(BUCKET_NODE), hash_(hash), next_(next), data_(std::forward<Args>(args)...) {}
+    };
+
+    struct array_node;
+
+    // One array slot holding a pointer to a data, bucket or array node,
+    // which carries its own type.
+    template<bool Inline, typename = void>
+    struct slot_impl {
+        node *ptr_ = nullptr;
+
+        node_type type() const { return ptr_ == nullptr ? EMPTY_NODE : ptr_->type_; }
+
+        array_node *child() const { return static_cast<array_node *>(ptr_); }
+
+        // kind_ of the child array, whose head type() has read already
+        uint8_t child_kind() const { return child()->kind_; }
+
+        bucket_node *bucket() const { return static_cast<bucket_node *>(ptr_); }
+
+        value_type &value() { return static_cast<data_node *>(ptr_)->data_; }
+
+        const value_type &value() const { return static_cast<const data_node *>(ptr_)->data_; }
+
+        // full hash of the entry or bucket here
+        std::size_t hash(const BasicHashTable &) const {
+            return type() == DATA_NODE ? static_cast<const data_node *>(ptr_)->hash_ : bucket()->hash_;
+        }
+
+        // whether the entry here has the given key, whose full hash is hash
+        template<typename K>
+        bool matches(const BasicHashTable &ht, std::size_t hash, const K &key) const {
+            auto dn = static_cast<const data_node *>(ptr_);
+            return dn->hash_ == hash && ht.key_equal_(dn->data_.first, key);
+        }
+
+        void set_child(array_node *arr) { ptr_ = arr; }
+
+        void set_bucket(bucket_node *bucket) { ptr_ = bucket; }
+
+        // constructs the entry from args
+        template<typename... Args>
+        void emplace(BasicHashTable &ht, std::size_t hash, Args &&... args) {
+            ptr_ = ht.new_data_node(hash, std::forward<Args>(args)...);
+        }
+
+        void destroy(BasicHashTable &ht) {
+            ht.delete_data_node(static_cast<data_node *>(ptr_));
+            ptr_ = nullptr;
+        }
+
+        // forgets a child array or bucket without touching it
+        void clear() { ptr_ = nullptr; }
+
+        // hands the entry, bucket or child array over to an empty slot, or
+        // to the slot holding the array this one is in
+        void relocate_to(slot_impl &other) {
+            other.ptr_ = ptr_;
+            ptr_ = nullptr;
+        }
+
+        // element destructor without giving the node back, for teardown
+        void destroy_value() { static_cast<data_node *>(ptr_)->~data_node(); }
+
+        // reading the type already needs the node
+        void prefetch() const {
+            if (ptr_ != nullptr) NEATLIB_PREFETCH(ptr_);
+        }
+    };
+
+    // One array slot holding the entry itself or a child array or bucket
+    // pointer, told apart by a one byte tag. Keys this small are cheap to
+    // compare and hash, so no hash is kept for them. A child array's kind
+    // is kept next to the tag, in what would be padding, so a walk knows
+    // where the child's slot is before the child is read.
+    template<typename Dummy>
+    struct slot_impl<true, Dummy> {
+        union {
+            array_node *child_;
+            bucket_node *bucket_;
+            typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type entry_;
+        };
+        node_type type_ = EMPTY_NODE;
+        uint8_t child_kind_ = 0;
+
+        slot_impl() : child_(nullptr) {}
+
+        node_type type() const { return type_; }
+
+        array_node *child() const { return child_; }
+
+        uint8_t child_kind() const { return child_kind_; }
+
+        bucket_node *bucket() const { return bucket_; }
+
+        value_type &value() { return *reinterpret_cast<value_type *>(&entry_); }
+
+        const value_type &value() const { return *reinterpret_cast<const value_type *>(&entry_); }
+
+        std::size_t hash(const BasicHashTable &ht) const {
+            return type_ == DATA_NODE ? ht.hasher_(value().first) : bucket_->hash_;
+        }
+
+        template<typename K>
+        bool matches(const BasicHashTable &ht, std::size_t, const K &key) const {
+            return ht.key_equal_(value().first, key);
+        }
+
+        void set_child(array_node *arr) {
+            child_ = arr;
+            child_kind_ = arr->kind_;
+            type_ = ARRAY_NODE;
+        }
+
+        void set_bucket(bucket_node *bucket) {
+            bucket_ = bucket;
+            type_ = BUCKET_NODE;
+        }
+
+        template<typename... Args>
+        void emplace(BasicHashTable &, std::size_t, Args &&... args) {
+            new(&entry_) value_type(std::forward<Args>(args)...);
+            type_ = DATA_NODE;
+        }
+
+        void destroy(BasicHashTable &) {
+            clear();
+        }
+
+        void clear() {
+            child_ = nullptr;
+            type_ = EMPTY_NODE;
+        }
 
-        std::size_t hash() {
-            return Hash()(data_.first);
+        void relocate_to(slot_impl &other) {
+            if (type_ == ARRAY_NODE) {
+                other.child_ = child_;
+                other.child_kind_ = child_kind_;
+                other.type_ = ARRAY_NODE;
+            }
+            else if (type_ == BUCKET_NODE)
+                other.set_bucket(bucket_);
+            else {
+                other.entry_ = entry_;
+                other.type_ = DATA_NODE;
+            }
+            clear();
+        }
+
+        void destroy_value() {}
+
+        // entries are already here, only child arrays and buckets live elsewhere
+        void prefetch() const {
+            if (type_ == ARRAY_NODE || type_ == BUCKET_NODE) NEATLIB_PREFETCH(child_);
         }
     };
 
-    using node_ptr = std::unique_ptr<node>;
+    using slot = slot_impl<INLINE_ENTRIES>;
+
+    // Array layouts, picked by how many children an array has (like the
+    // inner nodes of an adaptive radix tree). An array starts as the
+    // smallest layout this ARRAY_SIZE has and moves to the next one up when
+    // it is full, or down once a removal leaves it three quarters below the
+    // next smaller capacity. The root is always full.
+    using node_kind = uint8_t;
 
+    constexpr static node_kind NODE4 = 0;
+    constexpr static node_kind NODE16 = 1;
+    constexpr static node_kind NODE48 = 2;
+    constexpr static node_kind NODE_FULL = 3;
+    // the full layout of the root, ROOT_ARRAY_SIZE wide
+    constexpr static node_kind NODE_ROOT = 4;
+
+    // level hash of a child in the compact layouts
+    using child_index = typename std::conditional<(ARRAY_SIZE <= 256), uint8_t, uint16_t>::type;
+
+    constexpr static std::size_t kind_capacity(node_kind kind) {
+        return kind == NODE4 ? 4 : kind == NODE16 ? 16 : kind == NODE48 ? 48 :
+                                                        kind == NODE_ROOT ? ROOT_ARRAY_SIZE : ARRAY_SIZE;
+    }
+
+    // a layout is only worth it when it holds fewer children than the full array
+    constexpr static bool kind_available(node_kind kind) {
+        return kind == NODE_FULL || kind_capacity(kind) < ARRAY_SIZE;
+    }
+
+    constexpr static node_kind next_kind(node_kind kind) {
+        for (node_kind k = kind + 1; k < NODE_FULL; k++)
+            if (kind_available(k)) return k;
+        return NODE_FULL;
+    }
+
+    // the same kind when there is nothing smaller
+    constexpr static node_kind prev_kind(node_kind kind) {
+        for (node_kind k = kind; k > NODE4; k--)
+            if (kind_available(k - 1)) return k - 1;
+        return kind;
+    }
+
+    constexpr static node_kind SMALLEST_KIND = kind_available(NODE4) ? NODE4 : next_kind(NODE4);
+
+    // Common head of every layout. Nodes are owned by the table's slab
+    // pools, not by their parents, so the trie links are plain pointers.
     struct array_node : node {
-        std::array<std::unique_ptr<node>, ARRAY_SIZE> arr_;
+        node_kind kind_;
+        // slots that are not empty
+        uint32_t count_;
+
+        explicit array_node(node_kind kind) : node(ARRAY_NODE),
+                                              kind_(kind),
+                                              count_(0) {}
+    };
 
-        array_node() : node(ARRAY_NODE),
-                       arr_() {}
+    // Up to CAP children in the first count_ slots, keys_[i] being the
+    // level hash of slots_[i]. They are not sorted, a removal moves the last
+    // child into the gap.
+    template<std::size_t CAP>
+    struct compact_node : array_node {
+        child_index keys_[CAP];
+        std::array<slot, CAP> slots_;
 
-        constexpr static std::size_t size() { return ARRAY_SIZE; }
+        explicit compact_node(node_kind kind) : array_node(kind),
+                                                keys_(),
+                                                slots_() {}
     };
 
-    struct array_node_pool {
-        std::stack<std::unique_ptr<array_node>> stack_;
+    using node4 = compact_node<4>;
+    using node16 = compact_node<16>;
 
-        std::unique_ptr<array_node> get() {
-            std::unique_ptr<node> n = std::move(stack_.front());
-            stack_.pop();
-            return std::move(n);
+    // A compact node of 48 with an index from level hash to position + 1
+    // (0 for no child), so finding a child is one lookup instead of a scan.
+    struct node48 : compact_node<48> {
+        uint8_t index_[ARRAY_SIZE];
+
+        node48() : compact_node<48>(NODE48),
+                   index_() {}
+    };
+
+    struct full_node : array_node {
+        std::array<slot, ARRAY_SIZE> arr_;
+
+        full_node() : array_node(NODE_FULL),
+                      arr_() {}
+    };
+
+    struct root_node : array_node {
+        std::array<slot, ROOT_ARRAY_SIZE> arr_;
+
+        root_node() : array_node(NODE_ROOT),
+                      arr_() {}
+    };
+
+    constexpr static std::size_t kind_bytes(node_kind kind) {
+        return kind == NODE4 ? sizeof(node4) : kind == NODE16 ? sizeof(node16) :
+                                               kind == NODE48 ? sizeof(node48) :
+                                               kind == NODE_ROOT ? sizeof(root_node) : sizeof(full_node);
+    }
+
+    using data_node_pool = SlabPool<data_node, Allocator>;
+    using bucket_node_pool = SlabPool<bucket_node, Allocator>;
+    using node4_pool = SlabPool<node4, Allocator>;
+    using node16_pool = SlabPool<node16, Allocator>;
+    using node48_pool = SlabPool<node48, Allocator>;
+    using full_node_pool = SlabPool<full_node, Allocator>;
+
+    template<typename... Args>
+    data_node *new_data_node(std::size_t hash, Args &&... args) {
+        data_node *ret = data_pool_.Allocate();
+        try {
+            return new(ret) data_node(hash, std::forward<Args>(args)...);
+        } catch (...) {
+            data_pool_.Deallocate(ret);
+            throw;
+        }
+    }
+
+    void delete_data_node(data_node *dn) {
+        dn->~data_node();
+        data_pool_.Deallocate(dn);
+    }
+
+    template<typename... Args>
+    bucket_node *new_bucket_node(std::size_t hash, bucket_node *next, Args &&... args) {
+        bucket_node *ret = bucket_pool_.Allocate();
+        try {
+            return new(ret) bucket_node(hash, next, std::forward<Args>(args)...);
+        } catch (...) {
+            bucket_pool_.Deallocate(ret);
+            throw;
         }
+    }
 
-        array_node *get_ptr() {
-            auto ret = stack_.top().release();
-            stack_.pop();
-            return ret;
+    void delete_bucket_node(bucket_node *bn) {
+        bn->~bucket_node();
+        bucket_pool_.Deallocate(bn);
+    }
+
+    array_node *new_array_node(node_kind kind) {
+        switch (kind) {
+            case NODE4:
+                return new(node4_pool_.Allocate()) node4(NODE4);
+            case NODE16:
+                return new(node16_pool_.Allocate()) node16(NODE16);
+            case NODE48:
+                return new(node48_pool_.Allocate()) node48();
+            default:
+                return new(full_pool_.Allocate()) full_node();
+        }
+    }
+
+    void delete_array_node(array_node *arr) {
+        switch (arr->kind_) {
+            case NODE4:
+                static_cast<node4 *>(arr)->~node4();
+                node4_pool_.Deallocate(static_cast<node4 *>(arr));
+                break;
+            case NODE16:
+                static_cast<node16 *>(arr)->~node16();
+                node16_pool_.Deallocate(static_cast<node16 *>(arr));
+                break;
+            case NODE48:
+                static_cast<node48 *>(arr)->~node48();
+                node48_pool_.Deallocate(static_cast<node48 *>(arr));
+                break;
+            default:
+                static_cast<full_node *>(arr)->~full_node();
+                full_pool_.Deallocate(static_cast<full_node *>(arr));
         }
+    }
 
-        void put() { stack_.push(std::make_unique<array_node>()); }
+    static slot *find_child4(node4 *arr, std::size_t idx) {
+        for (uint32_t i = 0; i < arr->count_; i++)
+            if (arr->keys_[i] == idx) return &arr->slots_[i];
+        return nullptr;
+    }
 
-        void put(std::size_t count) {
-            for (std::size_t i = 0; i < count; i++) put();
+    static slot *find_child16(node16 *arr, std::size_t idx) {
+#ifdef NEATLIB_BASIC_HASH_TABLE_SSE2
+        if (sizeof(child_index) == 1) {
+            __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i *>(arr->keys_));
+            __m128i match = _mm_cmpeq_epi8(keys, _mm_set1_epi8(static_cast<char>(idx)));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match)) & ((1u << arr->count_) - 1);
+            return mask == 0 ? nullptr : &arr->slots_[__builtin_ctz(mask)];
         }
+#endif
+        for (uint32_t i = 0; i < arr->count_; i++)
+            if (arr->keys_[i] == idx) return &arr->slots_[i];
+        return nullptr;
+    }
+
+    // The slot of the child at level hash idx, nullptr when there is none.
+    static slot *find_child(array_node *arr, std::size_t idx) {
+        switch (arr->kind_) {
+            case NODE4:
+                return find_child4(static_cast<node4 *>(arr), idx);
+            case NODE16:
+                return find_child16(static_cast<node16 *>(arr), idx);
+            case NODE48: {
+                auto n = static_cast<node48 *>(arr);
+                return n->index_[idx] == 0 ? nullptr : &n->slots_[n->index_[idx] - 1];
+            }
+            case NODE_ROOT: {
+                slot *s = &static_cast<root_node *>(arr)->arr_[idx];
+                return s->type() == EMPTY_NODE ? nullptr : s;
+            }
+            default: {
+                slot *s = &static_cast<full_node *>(arr)->arr_[idx];
+                return s->type() == EMPTY_NODE ? nullptr : s;
+            }
+        }
+    }
+
+    static const slot *find_child(const array_node *arr, std::size_t idx) {
+        return find_child(const_cast<array_node *>(arr), idx);
+    }
+
+    // The slot find_child(arr, idx) ends up at, for an arr of the given
+    // kind: nullptr when a compact layout has no such child, a possibly
+    // empty slot of the full layouts. Reads only what prefetch_child()
+    // asked for: nothing of a full array, the index entry of a node48, the
+    // head and keys of a node4 or node16.
+    static const slot *probe_child(const array_node *arr, node_kind kind, std::size_t idx) {
+        switch (kind) {
+            case NODE4:
+                return find_child4(static_cast<node4 *>(const_cast<array_node *>(arr)), idx);
+            case NODE16:
+                return find_child16(static_cast<node16 *>(const_cast<array_node *>(arr)), idx);
+            case NODE48: {
+                auto n = static_cast<const node48 *>(arr);
+                return n->index_[idx] == 0 ? nullptr : &n->slots_[n->index_[idx] - 1];
+            }
+            case NODE_ROOT:
+                return &static_cast<const root_node *>(arr)->arr_[idx];
+            default:
+                return &static_cast<const full_node *>(arr)->arr_[idx];
+        }
+    }
+
+    // Prefetches what probe_child(arr, kind, idx) reads of a compact arr:
+    // all of a node4, slots included, so finding the slot and reading it
+    // take one round trip; the head and keys of a node16, whose slot is
+    // asked for once the keys are read; the index entry of a node48, for
+    // the same reason. A full array needs no prefetch but the slot itself.
+    static void prefetch_child(const array_node *arr, node_kind kind, std::size_t idx) {
+        if (kind == NODE4)
+            prefetch_lines(arr, sizeof(node4));
+        else if (kind == NODE16)
+            NEATLIB_PREFETCH(arr);
+        else
+            NEATLIB_PREFETCH(&static_cast<const node48 *>(arr)->index_[idx]);
+    }
+
+    static void prefetch_lines(const void *p, std::size_t bytes) {
+        auto line = reinterpret_cast<uintptr_t>(p) & ~uintptr_t(63);
+        for (auto end = reinterpret_cast<uintptr_t>(p) + bytes; line < end; line += 64)
+            NEATLIB_PREFETCH(reinterpret_cast<const void *>(line));
+    }
+
+    // Positions 0 to positions(arr) - 1 hold every child of arr; the
+    // compact layouts have no holes, the full ones have.
+    static std::size_t positions(const array_node *arr) {
+        return arr->kind_ >= NODE_FULL ? kind_capacity(arr->kind_) : arr->count_;
+    }
+
+    static slot *slot_at(array_node *arr, std::size_t pos) {
+        switch (arr->kind_) {
+            case NODE4:
+                return &static_cast<node4 *>(arr)->slots_[pos];
+            case NODE16:
+                return &static_cast<node16 *>(arr)->slots_[pos];
+            case NODE48:
+                return &static_cast<node48 *>(arr)->slots_[pos];
+            case NODE_ROOT:
+                return &static_cast<root_node *>(arr)->arr_[pos];
+            default:
+                return &static_cast<full_node *>(arr)->arr_[pos];
+        }
+    }
+
+    static const slot *slot_at(const array_node *arr, std::size_t pos) {
+        return slot_at(const_cast<array_node *>(arr), pos);
+    }
+
+    // level hash of the child at position pos
+    static std::size_t key_at(const array_node *arr, std::size_t pos) {
+        switch (arr->kind_) {
+            case NODE4:
+                return static_cast<const node4 *>(arr)->keys_[pos];
+            case NODE16:
+                return static_cast<const node16 *>(arr)->keys_[pos];
+            case NODE48:
+                return static_cast<const node48 *>(arr)->keys_[pos];
+            default:
+                return pos;
+        }
+    }
+
+    static slot *first_child(array_node *arr) {
+        std::size_t pos = 0;
+        while (slot_at(arr, pos)->type() == EMPTY_NODE) ++pos;
+        return slot_at(arr, pos);
+    }
+
+    static bool has_room(const array_node *arr) {
+        return arr->count_ < kind_capacity(arr->kind_);
+    }
+
+    static bool should_shrink(const array_node *arr) {
+        node_kind smaller = prev_kind(arr->kind_);
+        return smaller != arr->kind_ && arr->count_ <= kind_capacity(smaller) * 3 / 4;
+    }
+
+    // Takes the (empty) slot for level hash idx in an array with room left.
+    static slot *add_child(array_node *arr, std::size_t idx) {
+        assert(has_room(arr));
+        std::size_t pos = arr->count_++;
+        switch (arr->kind_) {
+            case NODE4: {
+                auto n = static_cast<node4 *>(arr);
+                n->keys_[pos] = static_cast<child_index>(idx);
+                return &n->slots_[pos];
+            }
+            case NODE16: {
+                auto n = static_cast<node16 *>(arr);
+                n->keys_[pos] = static_cast<child_index>(idx);
+                return &n->slots_[pos];
+            }
+            case NODE48: {
+                auto n = static_cast<node48 *>(arr);
+                n->keys_[pos] = static_cast<child_index>(idx);
+                n->index_[idx] = static_cast<uint8_t>(pos + 1);
+                return &n->slots_[pos];
+            }
+            case NODE_ROOT:
+                return &static_cast<root_node *>(arr)->arr_[idx];
+            default:
+                return &static_cast<full_node *>(arr)->arr_[idx];
+        }
+    }
+
+    template<typename Compact>
+    static void erase_at(Compact *arr, std::size_t pos) {
+        std::size_t last = --arr->count_;
+        if (pos != last) {
+            arr->slots_[last].relocate_to(arr->slots_[pos]);
+            arr->keys_[pos] = arr->keys_[last];
+        }
+    }
+
+    // Gives up the slot for level hash idx, which must be empty by now.
+    static void remove_child(array_node *arr, std::size_t idx) {
+        switch (arr->kind_) {
+            case NODE4: {
+                auto n = static_cast<node4 *>(arr);
+                erase_at(n, find_child(arr, idx) - n->slots_.data());
+                break;
+            }
+            case NODE16: {
+                auto n = static_cast<node16 *>(arr);
+                erase_at(n, find_child(arr, idx) - n->slots_.data());
+                break;
+            }
+            case NODE48: {
+                auto n = static_cast<node48 *>(arr);
+                std::size_t pos = n->index_[idx] - 1;
+                n->index_[idx] = 0;
+                erase_at(n, pos);
+                if (pos != n->count_) n->index_[n->keys_[pos]] = static_cast<uint8_t>(pos + 1);
+                break;
+            }
+            default:
+                --arr->count_;
+        }
+    }
+
+    // Moves the children of arr into a new array of the given layout and
+    // gives arr back to its pool.
+    array_node *resize(array_node *arr, node_kind kind) {
+        array_node *ret = new_array_node(kind);
+        for (std::size_t pos = 0, n = positions(arr); pos < n; pos++) {
+            slot *s = slot_at(arr, pos);
+            if (s->type() == EMPTY_NODE) continue;
+            s->relocate_to(*add_child(ret, key_at(arr, pos)));
+        }
+        delete_array_node(arr);
+        return ret;
+    }
+
+    // Only the data nodes need their destructors run; the chunks under
+    // every node are released as a whole by the pools afterwards.
+    static void destroy_data_nodes(array_node &arr) {
+        for (std::size_t pos = 0, n = positions(&arr); pos < n; pos++) {
+            slot &child = *slot_at(&arr, pos);
+            if (child.type() == DATA_NODE) {
+                child.destroy_value();
+            } else if (child.type() == BUCKET_NODE) {
+                for (bucket_node *bn = child.bucket(); bn != nullptr; bn = bn->next_)
+                    bn->~bucket_node();
+            } else if (child.type() == ARRAY_NODE) {
+                destroy_data_nodes(*child.child());
+            }
+        }
+    }
+
+    static void collect_stats(const array_node &arr, std::size_t level, TrieStats &stats) {
+        for (std::size_t pos = 0, n = positions(&arr); pos < n; pos++) {
+            const slot &child = *slot_at(&arr, pos);
+            if (child.type() == EMPTY_NODE) continue;
+            if (child.type() == DATA_NODE) {
+                stats.RecordData(level);
+                if (!INLINE_ENTRIES) stats.node_bytes += sizeof(data_node);
+            } else if (child.type() == BUCKET_NODE) {
+                for (const bucket_node *bn = child.bucket(); bn != nullptr; bn = bn->next_) {
+                    stats.RecordData(level);
+                    stats.node_bytes += sizeof(bucket_node);
+                }
+            } else {
+                collect_stats(*child.child(), level + 1, stats);
+            }
+        }
+        stats.RecordArray(level, arr.count_, kind_capacity(arr.kind_));
+        stats.node_bytes += kind_bytes(arr.kind_);
+    }
+
+    // The entry of key in a bucket, and the entry before it (nullptr for
+    // the first one) when prev is given.
+    template<typename K>
+    bucket_node *find_in_bucket(bucket_node *bn, const K &key, bucket_node **prev = nullptr) const {
+        bucket_node *before = nullptr;
+        for (; bn != nullptr; before = bn, bn = bn->next_) {
+            if (key_equal_(bn->data_.first, key)) {
+                if (prev != nullptr) *prev = before;
+                return bn;
+            }
+        }
+        return nullptr;
+    }
+
+    // Snapshot records, see SaveSnapshot(). An array record is followed by
+    // ARRAY_SIZE references when it is full, otherwise by count_ level
+    // hashes (padded to 8 bytes) and the count_ references they belong to.
+    // A bucket record is followed by count_ entries from SNAPSHOT_ALIGN on.
+    struct snapshot_array {
+        uint32_t kind_;
+        uint32_t count_;
     };
 
-    struct locator {
-        std::unique_ptr<node> *loc_ref_ = nullptr;
+    struct snapshot_bucket {
+        uint64_t count_;
+    };
+
+    struct snapshot_entry {
+        uint64_t hash_;
+        Key key_;
+        T mapped_;
+    };
+
+    constexpr static std::size_t SNAPSHOT_ALIGN = alignof(snapshot_entry) > 8 ? alignof(snapshot_entry) : 8;
+
+    // The hashes of the keys whose first byte is 0 to 3 and all other bytes
+    // 0, folded together, so a snapshot opened with another Hash is refused
+    // instead of missing every lookup.
+    static uint64_t hash_fingerprint(const Hash &hash) {
+        uint64_t ret = 0;
+        for (unsigned char i = 0; i < 4; i++) {
+            typename std::aligned_storage<sizeof(Key), alignof(Key)>::type bytes{};
+            std::memcpy(&bytes, &i, 1);
+            ret = ret * 0x9E3779B97F4A7C15ULL ^ static_cast<uint64_t>(hash(*reinterpret_cast<const Key *>(&bytes)));
+        }
+        return ret;
+    }
+
+    static SnapshotHeader snapshot_header(const Hash &hash) {
+        SnapshotHeader header{};
+        header.hash_fingerprint_ = hash_fingerprint(hash);
+        header.hash_level_ = HASH_LEVEL;
+        header.root_hash_level_ = ROOT_HASH_LEVEL;
+        header.key_size_ = sizeof(Key);
+        header.mapped_size_ = sizeof(T);
+        header.entry_size_ = sizeof(snapshot_entry);
+        return header;
+    }
+
+    static void put_entry(char *dst, std::size_t hash, const value_type &value) {
+        new(dst) snapshot_entry{hash, value.first, value.second};
+    }
+
+    // Writes the records under a slot, children before parents, and returns
+    // the reference to the slot's own record.
+    uint64_t save_slot(SnapshotWriter &out, const slot &s) const {
+        if (s.type() == DATA_NODE) {
+            char rec[sizeof(snapshot_entry)] = {};
+            put_entry(rec, s.hash(*this), s.value());
+            return SnapshotRef::Make(out.Append(rec, sizeof(rec)), SnapshotRef::kEntry);
+        }
+        if (s.type() == BUCKET_NODE) {
+            std::size_t count = 0;
+            for (const bucket_node *bn = s.bucket(); bn != nullptr; bn = bn->next_) ++count;
+            std::vector<char> rec(SNAPSHOT_ALIGN + count * sizeof(snapshot_entry), 0);
+            reinterpret_cast<snapshot_bucket *>(rec.data())->count_ = count;
+            char *dst = rec.data() + SNAPSHOT_ALIGN;
+            for (const bucket_node *bn = s.bucket(); bn != nullptr; bn = bn->next_, dst += sizeof(snapshot_entry))
+                put_entry(dst, bn->hash_, bn->data_);
+            return SnapshotRef::Make(out.Append(rec.data(), rec.size()), SnapshotRef::kBucket);
+        }
+        assert(s.type() == ARRAY_NODE);
+        return save_array(out, *s.child());
+    }
 
-        std::size_t level_hash(std::size_t hash, std::size_t level) {
-//            std::size_t mask = (ARRAY_SIZE - 1);
-//            std::size_t ret = (hash >> (sizeof(Key) * 8 - HASH_LEVEL * level) ) & mask ;
-//            assert(ret < ARRAY_SIZE);
-//            return ret;
-            return util::level_hash<Key>(hash, level, ARRAY_SIZE, HASH_LEVEL);
+    uint64_t save_array(SnapshotWriter &out, const array_node &arr) const {
+        bool full = arr.kind_ >= NODE_FULL;
+        std::size_t refs = positions(&arr);
+        std::size_t keys_bytes = full ? 0 : (refs * sizeof(child_index) + 7) / 8 * 8;
+        std::vector<char> rec(sizeof(snapshot_array) + keys_bytes + refs * sizeof(uint64_t), 0);
+        auto head = reinterpret_cast<snapshot_array *>(rec.data());
+        head->kind_ = arr.kind_;
+        head->count_ = arr.count_;
+        auto keys = reinterpret_cast<child_index *>(rec.data() + sizeof(snapshot_array));
+        auto ref = reinterpret_cast<uint64_t *>(rec.data() + sizeof(snapshot_array) + keys_bytes);
+        for (std::size_t pos = 0; pos < refs; pos++) {
+            const slot &child = *slot_at(&arr, pos);
+            if (child.type() == EMPTY_NODE) continue;
+            if (!full) keys[pos] = static_cast<child_index>(key_at(&arr, pos));
+            ref[pos] = save_slot(out, child);
         }
+        return SnapshotRef::Make(out.Append(rec.data(), rec.size()), SnapshotRef::kArray);
+    }
+
+    // whether a lookup by a K can throw
+    template<typename K>
+    struct nothrow_lookup : std::integral_constant<bool,
+            noexcept(std::declval<const Hash &>()(std::declval<const K &>())) &&
+            util::nothrow_key_equal<KeyEqual, Key, K>::value> {};
+
+    constexpr static bool NOTHROW_LOOKUP = nothrow_lookup<Key>::value;
+
+    // Hash and KeyEqual both declare is_transparent, so the lookups take
+    // any type they take besides Key, see transparent_key.
+    constexpr static bool TRANSPARENT_LOOKUP =
+            util::is_transparent<Hash>::value && util::is_transparent<KeyEqual>::value;
+
+    // The single key lookups have an overload for Key and one for every
+    // other K, which only exists with TRANSPARENT_LOOKUP. The batches take
+    // arrays of Key, or of any K with TRANSPARENT_LOOKUP.
+    template<typename K>
+    using transparent_key = typename std::enable_if<TRANSPARENT_LOOKUP && !std::is_same<K, Key>::value>::type;
+
+    template<typename K>
+    using batch_key = typename std::enable_if<TRANSPARENT_LOOKUP || std::is_same<K, Key>::value>::type;
+
+    // A lookup that does not keep the path a removal needs.
+    template<typename K>
+    const value_type *find_entry(const K &key) const noexcept(nothrow_lookup<K>::value) {
+        std::size_t hash = hasher_(key);
+        // the root is always full, so its slot needs no layout switch
+        const slot *s = &root_node_.arr_[level_hash(hash, 0)];
+        for (std::size_t level = 1; s != nullptr; level++) {
+            if (s->type() == ARRAY_NODE) {
+                assert(level < MAX_LEVEL);
+                s = find_child(s->child(), level_hash(hash, level));
+            } else if (s->type() == DATA_NODE) {
+                return s->matches(*this, hash, key) ? &s->value() : nullptr;
+            } else if (s->type() == BUCKET_NODE) {
+                return s->bucket()->hash_ == hash ? entry_of(find_in_bucket(s->bucket(), key)) : nullptr;
+            } else {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    struct locator {
+        slot *loc_ref_ = nullptr;
+        // the entry when loc_ref_ holds a bucket, and the one before it
+        bucket_node *bucket_ = nullptr;
+        bucket_node *prev_ = nullptr;
+        bool inserted_ = false;
+        // arrays passed on the way to loc_ref_ and the slot taken in each,
+        // path_[depth_] is the array holding loc_ref_ (finding only)
+        std::array<array_node *, MAX_LEVEL> path_;
+        std::array<std::size_t, MAX_LEVEL> path_index_;
+        std::size_t depth_ = 0;
 
         const Key &key() {
-            return static_cast<data_node *>(loc_ref_->get())->data_.first;
+            return value().first;
         }
 
-        const std::pair<const Key, T> &value() {
-            return static_cast<data_node *>(loc_ref_->get())->data_;
+        std::pair<const Key, T> &value() {
+            return bucket_ != nullptr ? bucket_->data_ : loc_ref_->value();
         }
 
+        // for insert_colliding() on a slot found some other way
+        locator() = default;
+
         // for finding only
-        explicit locator(BasicHashTable &ht, const Key &key) {
+        template<typename K>
+        explicit locator(BasicHashTable &ht, const K &key) {
             std::size_t hash = ht.hasher_(key);
             std::size_t level = 0;
             // this will not go out this scope
             array_node *curr_arr_ptr = &ht.root_node_;
 
-            for (; level < ht.max_level_; level++) {
+            for (; level < MAX_LEVEL; level++) {
                 std::size_t curr_hash = level_hash(hash, level);
-                std::unique_ptr<node> &node_ptr_ref = curr_arr_ptr->arr_[curr_hash];
-                if (node_ptr_ref == nullptr) {
+                slot *node_ptr = find_child(curr_arr_ptr, curr_hash);
+                path_[level] = curr_arr_ptr;
+                path_index_[level] = curr_hash;
+                depth_ = level;
+                if (node_ptr == nullptr) {
                     loc_ref_ = nullptr;
                     break;
-                } else if (node_ptr_ref->type_ == DATA_NODE) {
-                    if (hash == static_cast<data_node *>(node_ptr_ref.get())->hash())
-                        loc_ref_ = &node_ptr_ref;
+                } else if (node_ptr->type() == DATA_NODE) {
+                    if (node_ptr->matches(ht, hash, key))
+                        loc_ref_ = node_ptr;
                     else
                         loc_ref_ = nullptr;
                     break;
+                } else if (node_ptr->type() == BUCKET_NODE) {
+                    if (node_ptr->bucket()->hash_ == hash)
+                        bucket_ = ht.find_in_bucket(node_ptr->bucket(), key, &prev_);
+                    loc_ref_ = bucket_ != nullptr ? node_ptr : nullptr;
+                    break;
                 } else {
-                    assert(node_ptr_ref->type_ == ARRAY_NODE);
-                    curr_arr_ptr = static_cast<array_node *>(node_ptr_ref.get());
+                    assert(node_ptr->type() == ARRAY_NODE);
+                    curr_arr_ptr = node_ptr->child();
                 }
             }
         }
 
-        // for insertion only
-        locator(BasicHashTable &ht, const Key &key, const T &mapped) {
+        // For insertion only, the entry is constructed from args when key is
+        // not there yet. Either way loc_ref_ (and bucket_) end up at the
+        // entry with key; inserted_ tells which case it was.
+        template<typename Arg, typename... Args>
+        locator(BasicHashTable &ht, const Key &key, Arg &&arg, Args &&... args) {
             std::size_t hash = ht.hasher_(key);
             std::size_t level = 0;
             // this will not go out this scope
             array_node *curr_arr_ptr = &ht.root_node_;
+            // the slot curr_arr_ptr hangs off, none for the root
+            slot *parent_ptr = nullptr;
 
-            for (; level < ht.max_level_; level++) {
+            for (; level < MAX_LEVEL; level++) {
                 std::size_t curr_hash = level_hash(hash, level);
-                assert(curr_hash <= ARRAY_SIZE);
-                std::unique_ptr<node> &node_ptr_ref = curr_arr_ptr->arr_[curr_hash];
+                assert(curr_hash < (level == 0 ? ROOT_ARRAY_SIZE : ARRAY_SIZE));
+                slot *node_ptr = find_child(curr_arr_ptr, curr_hash);
 
                 // this is the place to Insert
-                if (node_ptr_ref == nullptr) {
-                    node_ptr_ref = std::make_unique<data_node>(key, mapped);
-                    loc_ref_ = &node_ptr_ref;
+                if (node_ptr == nullptr) {
+                    if (!has_room(curr_arr_ptr)) {
+                        // the root is full sized, so never gets here
+                        curr_arr_ptr = ht.resize(curr_arr_ptr, next_kind(curr_arr_ptr->kind_));
+                        parent_ptr->set_child(curr_arr_ptr);
+                    }
+                    node_ptr = add_child(curr_arr_ptr, curr_hash);
+                    try {
+                        node_ptr->emplace(ht, hash, std::forward<Arg>(arg), std::forward<Args>(args)...);
+                    } catch (...) {
+                        remove_child(curr_arr_ptr, curr_hash);
+                        throw;
+                    }
+                    loc_ref_ = node_ptr;
+                    inserted_ = true;
                     break;
-                } else if (node_ptr_ref->type_ == DATA_NODE) {
-                    // this will not go out this scope
-                    data_node *temp_data_ptr = static_cast<data_node *>(node_ptr_ref.get());
+                } else if (node_ptr->type() != ARRAY_NODE) {
+                    std::size_t temp_hash = node_ptr->hash(ht);
 
                     // first, we should judge whether this is the same key with the key to be inserted
-                    if (temp_data_ptr->hash() == hash) {
-                        // the key is already there, to Update the user should use Update rather than Insert
-                        loc_ref_ = nullptr;
+                    if (temp_hash == hash) {
+                        insert_colliding(ht, node_ptr, hash, key, std::forward<Arg>(arg), std::forward<Args>(args)...);
                         break;
                     }
 
-                    temp_data_ptr = static_cast<data_node *>(node_ptr_ref.release());
-                    if (ht.pool_.stack_.empty()) {
-                        node_ptr_ref = std::make_unique<array_node>();
-                    } else {
-                        node_ptr_ref.reset(ht.pool_.get_ptr());
-                    }
-
                     // this will not go out this scope
-                    auto temp_arr_ptr = static_cast<array_node *>(node_ptr_ref.get());
-
-                    std::size_t temp_hash = level_hash(temp_data_ptr->hash(), level + 1);
-                    temp_arr_ptr->arr_[temp_hash].reset(temp_data_ptr);
+                    array_node *temp_arr_ptr = ht.new_array_node(SMALLEST_KIND);
+                    node_ptr->relocate_to(*add_child(temp_arr_ptr, level_hash(temp_hash, level + 1)));
+                    node_ptr->set_child(temp_arr_ptr);
 
+                    parent_ptr = node_ptr;
                     curr_arr_ptr = temp_arr_ptr;
                     continue;
                 } else {
-                    assert(node_ptr_ref->type_ == ARRAY_NODE);
-                    curr_arr_ptr = static_cast<array_node *>(node_ptr_ref.get());
+                    assert(node_ptr->type() == ARRAY_NODE);
+                    parent_ptr = node_ptr;
+                    curr_arr_ptr = node_ptr->child();
+                    continue;
+                }
+            }
+        }
+
+        // Insertion into a slot whose entry or bucket has the same full hash.
+        // The key may already be there, to Update the user should use Update
+        // rather than Insert. Otherwise the slot ends up with a bucket.
+        template<typename... Args>
+        void insert_colliding(BasicHashTable &ht, slot *node_ptr, std::size_t hash,
+                              const Key &key, Args &&... args) {
+            loc_ref_ = node_ptr;
+            if (node_ptr->type() == BUCKET_NODE) {
+                bucket_ = ht.find_in_bucket(node_ptr->bucket(), key);
+                if (bucket_ != nullptr) return;
+                bucket_ = ht.new_bucket_node(hash, node_ptr->bucket(), std::forward<Args>(args)...);
+                node_ptr->set_bucket(bucket_);
+            } else {
+                if (node_ptr->matches(ht, hash, key)) return;
+                bucket_ = ht.new_bucket_node(hash, nullptr, std::forward<Args>(args)...);
+                try {
+                    prev_ = ht.new_bucket_node(hash, bucket_, std::move(node_ptr->value()));
+                } catch (...) {
+                    ht.delete_bucket_node(bucket_);
+                    bucket_ = nullptr;
+                    throw;
+                }
+                node_ptr->destroy(ht);
+                node_ptr->set_bucket(prev_);
+            }
+            inserted_ = true;
+        }
+    };
+
+    // How many slots ahead of the scan position the iterators prefetch.
+    constexpr static std::size_t PREFETCH_DISTANCE = 8;
+
+    // Depth first walk over the trie. Every frame remembers how many
+    // non-empty slots of its array are still ahead, so the walk leaves an
+    // array as soon as its last entry is seen instead of scanning the empty
+    // tail. While scanning, the node behind the slot PREFETCH_DISTANCE
+    // ahead is prefetched, so child arrays and data nodes are usually in
+    // cache by the time the walk gets there.
+    template<bool Const>
+    class iterator_impl {
+    private:
+        using table_value_type = std::pair<const Key, T>;
+        using array_ptr = typename std::conditional<Const, const array_node *, array_node *>::type;
+        using bucket_ptr = typename std::conditional<Const, const bucket_node *, bucket_node *>::type;
+
+        friend class BasicHashTable;
+        friend class iterator_impl<!Const>;
+
+        void push(array_ptr arr) {
+            arr_[depth_] = arr;
+            index_[depth_] = 0;
+            left_[depth_] = arr->count_;
+            ++depth_;
+            for (std::size_t i = 0, n = positions(arr); i < PREFETCH_DISTANCE && i < n; i++)
+                slot_at(arr, i)->prefetch();
+        }
+
+        // moves to the next entry after the current position, or to end()
+        void find_next() {
+            if (bucket_ != nullptr) {
+                bucket_ = bucket_->next_;
+                if (bucket_ != nullptr) return;
+            }
+            while (depth_ > 0) {
+                std::size_t top = depth_ - 1;
+                if (left_[top] == 0) {
+                    --depth_;
                     continue;
                 }
+                array_ptr arr = arr_[top];
+                std::size_t i = index_[top];
+                while (slot_at(arr, i)->type() == EMPTY_NODE) ++i;
+                index_[top] = i + 1;
+                --left_[top];
+                if (i + PREFETCH_DISTANCE < positions(arr)) slot_at(arr, i + PREFETCH_DISTANCE)->prefetch();
+                if (slot_at(arr, i)->type() == DATA_NODE) return;
+                if (slot_at(arr, i)->type() == BUCKET_NODE) {
+                    bucket_ = slot_at(arr, i)->bucket();
+                    return;
+                }
+                push(slot_at(arr, i)->child());
             }
         }
+
+        explicit iterator_impl(array_ptr root) {
+            push(root);
+            find_next();
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = table_value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = typename std::conditional<Const, const value_type &, value_type &>::type;
+        using pointer = typename std::conditional<Const, const value_type *, value_type *>::type;
+
+        iterator_impl() = default;
+
+        // iterator to const_iterator
+        template<bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+        iterator_impl(const iterator_impl<OtherConst> &other) :
+                arr_(), index_(other.index_), left_(other.left_), depth_(other.depth_), bucket_(other.bucket_) {
+            for (std::size_t i = 0; i < depth_; i++) arr_[i] = other.arr_[i];
+        }
+
+        reference operator*() const {
+            if (bucket_ != nullptr) return bucket_->data_;
+            return slot_at(arr_[depth_ - 1], index_[depth_ - 1] - 1)->value();
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        iterator_impl &operator++() {
+            find_next();
+            return *this;
+        }
+
+        iterator_impl operator++(int) {
+            iterator_impl ret = *this;
+            find_next();
+            return ret;
+        }
+
+        bool operator==(const iterator_impl &other) const {
+            if (depth_ != other.depth_ || bucket_ != other.bucket_) return false;
+            return depth_ == 0 || (arr_[depth_ - 1] == other.arr_[depth_ - 1] &&
+                                   index_[depth_ - 1] == other.index_[depth_ - 1]);
+        }
+
+        bool operator!=(const iterator_impl &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        std::array<array_ptr, MAX_LEVEL> arr_;
+        // next slot to look at in every frame, the current entry is one before it
+        std::array<std::size_t, MAX_LEVEL> index_;
+        std::array<uint32_t, MAX_LEVEL> left_;
+        std::size_t depth_ = 0;
+        // the entry when the current slot holds a bucket
+        bucket_ptr bucket_ = nullptr;
     };
 
-public:
-    BasicHashTable() {
-        std::size_t m = 1, num = ARRAY_SIZE, level = 1;
-        std::size_t total_bit = sizeof(Key) * 8;
-        if (total_bit < 64) {
-            for (std::size_t i = 0; i < total_bit; i++)
-                m *= 2;
-            for (; num < m; num += num * ARRAY_SIZE)
-                level++;
-        } else {
-            m = std::numeric_limits<std::size_t>::max();
-            auto m2 = m / 2;
-            for (; num < m2; num += num * ARRAY_SIZE)
-                level++;
-            level++;
+    // Keys whose trie walks FindBatch advances side by side.
+    constexpr static std::size_t BATCH_GROUP = 16;
+
+    template<typename K>
+    bool remove_entry(const K &key) {
+        locator locator_(*this, key);
+        if (locator_.loc_ref_ == nullptr)
+            return false;
+        if (erase_entry(locator_)) {
+            remove_child(locator_.path_[locator_.depth_], locator_.path_index_[locator_.depth_]);
+            contract(locator_);
+        }
+        --size_;
+        return true;
+    }
+
+    template<typename... Args>
+    std::pair<value_type *, bool> insert_entry(const Key &key, Args &&... args) {
+        locator locator_(*this, key, std::forward<Args>(args)...);
+        if (locator_.inserted_) ++size_;
+        return {&locator_.value(), locator_.inserted_};
+    }
+
+    static const value_type *entry_of(const bucket_node *bn) {
+        return bn != nullptr ? &bn->data_ : nullptr;
+    }
+
+    // Takes the entry locator_ found out of its slot. Returns whether the
+    // slot is empty now, it is not while the rest of a bucket is left.
+    bool erase_entry(locator &locator_) {
+        bucket_node *bn = locator_.bucket_;
+        if (bn == nullptr) {
+            locator_.loc_ref_->destroy(*this);
+            return true;
+        }
+        if (locator_.prev_ != nullptr)
+            locator_.prev_->next_ = bn->next_;
+        else if (bn->next_ != nullptr)
+            locator_.loc_ref_->set_bucket(bn->next_);
+        else
+            locator_.loc_ref_->clear();
+        delete_bucket_node(bn);
+        return locator_.loc_ref_->type() == EMPTY_NODE;
+    }
+
+    // Walks back up from the array that just lost an entry. An empty array
+    // is unlinked from its parent, an array left with a single entry hands
+    // it up to the parent slot; both go back to the pool. Stops at the
+    // first array that keeps more than one slot or a child array, so the
+    // trie is never deeper than its live keys need, after moving that array
+    // to a smaller layout if it has become sparse enough.
+    void contract(locator &locator_) {
+        for (std::size_t level = locator_.depth_; level > 0; level--) {
+            array_node *arr = locator_.path_[level];
+            array_node *parent = locator_.path_[level - 1];
+            slot &parent_slot = *find_child(parent, locator_.path_index_[level - 1]);
+            if (arr->count_ == 0) {
+                parent_slot.clear();
+                remove_child(parent, locator_.path_index_[level - 1]);
+            } else if (arr->count_ == 1 && first_child(arr)->type() != ARRAY_NODE) {
+                first_child(arr)->relocate_to(parent_slot);
+            } else {
+                if (should_shrink(arr)) parent_slot.set_child(resize(arr, prev_kind(arr->kind_)));
+                return;
+            }
+            delete_array_node(arr);
         }
+    }
+
+    // An input entry of BuildFrom(): its full hash, its sort key (see
+    // build_key()) and its position in the range.
+    struct build_entry {
+        std::size_t hash_;
+        std::size_t key_;
+        std::size_t pos_;
+    };
+
+    // Below this many entries per thread BuildFrom() does not start one more.
+    constexpr static std::size_t BUILD_MIN_PER_THREAD = 1 << 14;
+
+    // Whether the level hashes cut the hash into disjoint bit fields, which
+    // they do unless HASH_LEVEL is between 10 and 16.
+    constexpr static bool BUILD_KEYED = (std::size_t(1) << HASH_LEVEL) == ARRAY_SIZE;
+
+    // The hash with its level hashes in reverse order, level 0 in the top
+    // bits, so integer order sorts by level 0, then level 1 and so on, and
+    // every subtree is a contiguous run of the sorted entries at every level.
+    static std::size_t build_key(std::size_t hash) {
+        std::size_t ret = 0;
+        for (std::size_t level = 0; level < MAX_LEVEL; level++) {
+            std::size_t width = level == 0 ? ROOT_HASH_LEVEL : HASH_LEVEL;
+            if (width > HASH_BITS - level_shift(level)) width = HASH_BITS - level_shift(level);
+            ret = (ret << width) | level_hash(hash, level);
+        }
+        return ret;
+    }
+
+    // Orders the entries of one root slot like their sort keys would, then
+    // by position, so equal keys keep their range order. Without sort keys
+    // it compares the level hashes one by one.
+    bool build_less(const build_entry &a, const build_entry &b) const {
+        if (BUILD_KEYED) return a.key_ != b.key_ ? a.key_ < b.key_ : a.pos_ < b.pos_;
+        for (std::size_t level = 1; level < MAX_LEVEL; level++) {
+            std::size_t x = level_hash(a.hash_, level);
+            std::size_t y = level_hash(b.hash_, level);
+            if (x != y) return x < y;
+        }
+        return a.hash_ != b.hash_ ? a.hash_ < b.hash_ : a.pos_ < b.pos_;
+    }
+
+    // the smallest layout holding count children, which Insert would have grown to
+    constexpr static node_kind kind_for(std::size_t count) {
+        return count <= kind_capacity(SMALLEST_KIND) ? SMALLEST_KIND :
+               kind_available(NODE16) && count <= kind_capacity(NODE16) ? NODE16 :
+               kind_available(NODE48) && count <= kind_capacity(NODE48) ? NODE48 : NODE_FULL;
+    }
+
+    // Spans of at least this many entries are radix partitioned by their
+    // next level hash, shorter ones are sorted once and split by scanning.
+    constexpr static std::size_t BUILD_RADIX_MIN = ARRAY_SIZE > 64 ? ARRAY_SIZE : 64;
 
-        max_level_ = level;
-        max_ = m;
+    // Scratch space of one BuildFrom() thread.
+    struct build_buffers {
+        std::vector<build_entry> scratch_;
+        // ARRAY_SIZE + 1 group bounds for every level below the root
+        std::vector<std::size_t> bounds_;
     };
 
-    explicit BasicHashTable(std::size_t capacity) : BasicHashTable() {
+    // Fills the empty slot s, whose children would sit at the given level,
+    // with the entries [b, e) read from first, giving the trie the shape
+    // inserting them one by one would. Every array is made in the layout
+    // its child count needs. The entries are in range order within equal
+    // hashes, and sorted by build_less() when sorted is set. Keys already
+    // seen are skipped the way Insert skips them.
+    template<typename RandomIt>
+    void build_slot(slot &s, build_entry *b, build_entry *e, std::size_t level, RandomIt first,
+                    build_buffers &buf, bool sorted) {
+        bool same_hash = true;
+        if (sorted) {
+            same_hash = b->hash_ == (e - 1)->hash_;
+        } else {
+            for (const build_entry *it = b + 1; same_hash && it != e; ++it) same_hash = it->hash_ == b->hash_;
+        }
+        if (same_hash) {
+            s.emplace(*this, b->hash_, first[b->pos_]);
+            ++size_;
+            for (const build_entry *it = b + 1; it != e; ++it) {
+                locator locator_;
+                locator_.insert_colliding(*this, &s, it->hash_, first[it->pos_].first, first[it->pos_]);
+                if (locator_.inserted_) ++size_;
+            }
+            return;
+        }
+        if (!sorted && static_cast<std::size_t>(e - b) < BUILD_RADIX_MIN) {
+            std::sort(b, e, [this](const build_entry &x, const build_entry &y) { return build_less(x, y); });
+            sorted = true;
+        }
+        if (sorted) {
+            std::size_t children = 1;
+            for (const build_entry *it = b + 1; it != e; ++it)
+                children += level_hash(it->hash_, level) != level_hash((it - 1)->hash_, level);
+            array_node *arr = new_array_node(kind_for(children));
+            s.set_child(arr);
+            while (b != e) {
+                std::size_t idx = level_hash(b->hash_, level);
+                build_entry *group_end = b + 1;
+                while (group_end != e && level_hash(group_end->hash_, level) == idx)
+                    ++group_end;
+                build_child(arr, idx, b, group_end, level, first, buf, true);
+                b = group_end;
+            }
+            return;
+        }
+        // a stable counting sort, group idx ends up at [bounds[idx - 1], bounds[idx])
+        std::size_t *bounds = &buf.bounds_[level * (ARRAY_SIZE + 1)];
+        std::fill(bounds, bounds + ARRAY_SIZE + 1, 0);
+        for (const build_entry *it = b; it != e; ++it)
+            ++bounds[level_hash(it->hash_, level) + 1];
+        std::size_t children = 0;
+        for (std::size_t idx = 0; idx < ARRAY_SIZE; idx++) {
+            children += bounds[idx + 1] != 0;
+            bounds[idx + 1] += bounds[idx];
+        }
+        build_entry *scratch = buf.scratch_.data();
+        for (const build_entry *it = b; it != e; ++it)
+            scratch[bounds[level_hash(it->hash_, level)]++] = *it;
+        std::copy(scratch, scratch + (e - b), b);
+        assert(level < MAX_LEVEL);
+        array_node *arr = new_array_node(kind_for(children));
+        s.set_child(arr);
+        for (std::size_t idx = 0, start = 0; idx < ARRAY_SIZE; start = bounds[idx++]) {
+            if (bounds[idx] != start) build_child(arr, idx, b + start, b + bounds[idx], level, first, buf, false);
+        }
+    }
+
+    template<typename RandomIt>
+    void build_child(array_node *arr, std::size_t idx, build_entry *b, build_entry *e, std::size_t level,
+                     RandomIt first, build_buffers &buf, bool sorted) {
+        slot *child = add_child(arr, idx);
+        try {
+            build_slot(*child, b, e, level + 1, first, buf, sorted);
+        } catch (...) {
+            if (child->type() == EMPTY_NODE) remove_child(arr, idx);
+            throw;
+        }
+    }
+
+    // Runs f(0) to f(threads - 1) on as many threads, f(0) on the calling
+    // one, and rethrows the first exception any of them threw once all are
+    // done. Work a thread can not be started for, whatever the reason, runs
+    // on the calling thread. Every vector is sized before the first thread
+    // starts, so nothing can throw while a worker is still joinable.
+    template<typename F>
+    static void run_threads(std::size_t threads, const F &f) {
+        std::vector<std::exception_ptr> errors(threads);
+        std::vector<std::size_t> inline_work;
+        inline_work.reserve(threads);
+        inline_work.push_back(0);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (std::size_t t = 1; t < threads; t++) {
+            try {
+                workers.emplace_back([&f, &errors, t] {
+                    try {
+                        f(t);
+                    } catch (...) {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            } catch (...) {
+                inline_work.push_back(t);
+            }
+        }
+        for (std::size_t t : inline_work) {
+            try {
+                f(t);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        }
+        for (auto &worker : workers) worker.join();
+        for (auto &error : errors)
+            if (error) std::rethrow_exception(error);
+    }
+
+    // Takes over the nodes other built, see BuildFrom().
+    void adopt_nodes(BasicHashTable &other) {
+        data_pool_.Adopt(other.data_pool_);
+        bucket_pool_.Adopt(other.bucket_pool_);
+        node4_pool_.Adopt(other.node4_pool_);
+        node16_pool_.Adopt(other.node16_pool_);
+        node48_pool_.Adopt(other.node48_pool_);
+        full_pool_.Adopt(other.full_pool_);
+        size_ += other.size_;
+        other.size_ = 0;
+    }
+
+public:
+    // Forward iterators in trie order. Insert and Remove invalidate them.
+    using iterator = iterator_impl<false>;
+    using const_iterator = iterator_impl<true>;
+
+    explicit BasicHashTable(const Allocator &alloc = Allocator()) :
+            data_pool_(alloc), bucket_pool_(alloc), node4_pool_(alloc), node16_pool_(alloc),
+            node48_pool_(alloc), full_pool_(alloc) {}
+
+    explicit BasicHashTable(std::size_t capacity, const Allocator &alloc = Allocator()) :
+            BasicHashTable(alloc) {
         Reserve(capacity);
     }
 
+    BasicHashTable(const BasicHashTable &) = delete;
+
+    BasicHashTable &operator=(const BasicHashTable &) = delete;
+
+    // Runs the element destructors if there are any, then the pools hand
+    // their chunks back to the allocator without visiting single nodes.
+    ~BasicHashTable() {
+        if (!std::is_trivially_destructible<value_type>::value)
+            destroy_data_nodes(root_node_);
+    }
+
     void Reserve(std::size_t new_cap) {
         std::size_t new_arr = 0;
 
         if (new_cap % ARRAY_SIZE) new_arr = new_cap / ARRAY_SIZE;
         else new_arr = new_cap / ARRAY_SIZE + 1;
 
-        pool_.put(new_arr);
+        // new arrays start small and grow, so only count on the smallest layout
+        switch (SMALLEST_KIND) {
+            case NODE4:
+                node4_pool_.Reserve(new_arr);
+                break;
+            case NODE16:
+                node16_pool_.Reserve(new_arr);
+                break;
+            default:
+                full_pool_.Reserve(new_arr);
+        }
+        if (!INLINE_ENTRIES && new_cap > size_) data_pool_.Reserve(new_cap - size_);
+    }
+
+    // Inserts every (key, mapped) pair of a random access range into an
+    // empty table the way a loop of Insert would (the first of equal keys
+    // wins), spread over threads threads (0 for one per core). All keys are
+    // hashed and radix partitioned by their root slot first, then every
+    // root subtree is built on its own by one of the threads, partitioning
+    // its share further level by level and making each array in the layout
+    // its final child count needs, so nothing is split or resized on the
+    // way. Hash and KeyEqual
+    // must be callable from several threads at once. A table that already
+    // has entries just gets the Insert loop. If an element constructor
+    // throws, the table keeps the entries built so far.
+    template<typename Range>
+    void BuildFrom(const Range &range, std::size_t threads = 0) {
+        auto first = std::begin(range);
+        using iterator_type = decltype(first);
+        static_assert(std::is_base_of<std::random_access_iterator_tag,
+                              typename std::iterator_traits<iterator_type>::iterator_category>::value,
+                      "BuildFrom() needs a random access range");
+        std::size_t n = static_cast<std::size_t>(std::end(range) - first);
+        if (size_ != 0) {
+            for (std::size_t i = 0; i < n; i++) Insert(first[i].first, first[i].second);
+            return;
+        }
+        if (threads == 0) threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        threads = std::max<std::size_t>(1, std::min(threads, n / BUILD_MIN_PER_THREAD));
+        auto chunk_begin = [n, threads](std::size_t t) { return n / threads * t + std::min(t, n % threads); };
+
+        // hash and count the entries of every root slot, per thread
+        std::vector<std::size_t> hashes(n);
+        std::vector<std::size_t> offsets(threads * ROOT_ARRAY_SIZE, 0);
+        run_threads(threads, [&](std::size_t t) {
+            std::size_t *count = &offsets[t * ROOT_ARRAY_SIZE];
+            for (std::size_t i = chunk_begin(t), end = chunk_begin(t + 1); i < end; i++) {
+                hashes[i] = hasher_(first[i].first);
+                ++count[level_hash(hashes[i], 0)];
+            }
+        });
+        // root slot by root slot, each thread's share goes after the ones before
+        std::vector<std::size_t> slot_begin(ROOT_ARRAY_SIZE + 1, 0);
+        for (std::size_t idx = 0, at = 0; idx < ROOT_ARRAY_SIZE; idx++) {
+            slot_begin[idx] = at;
+            for (std::size_t t = 0; t < threads; t++) {
+                std::size_t count = offsets[t * ROOT_ARRAY_SIZE + idx];
+                offsets[t * ROOT_ARRAY_SIZE + idx] = at;
+                at += count;
+            }
+        }
+        slot_begin[ROOT_ARRAY_SIZE] = n;
+        std::vector<build_entry> entries(n);
+        run_threads(threads, [&](std::size_t t) {
+            std::size_t *at = &offsets[t * ROOT_ARRAY_SIZE];
+            for (std::size_t i = chunk_begin(t), end = chunk_begin(t + 1); i < end; i++)
+                entries[at[level_hash(hashes[i], 0)]++] =
+                        {hashes[i], BUILD_KEYED ? build_key(hashes[i]) : 0, i};
+        });
+        std::vector<std::size_t>().swap(hashes);
+
+        // Every thread builds into a table of its own, whose nodes this one
+        // takes over afterwards; only the root slots are shared, each
+        // written by the one thread that took it.
+        std::vector<std::unique_ptr<BasicHashTable>> workers;
+        for (std::size_t t = 0; t < threads; t++)
+            workers.emplace_back(new BasicHashTable(data_pool_.GetAllocator()));
+        std::atomic<std::size_t> next_slot(0);
+        std::exception_ptr error;
+        try {
+            run_threads(threads, [&](std::size_t t) {
+                BasicHashTable &worker = *workers[t];
+                build_buffers buf;
+                buf.bounds_.resize(MAX_LEVEL * (ARRAY_SIZE + 1));
+                for (std::size_t idx = next_slot++; idx < ROOT_ARRAY_SIZE; idx = next_slot++) {
+                    build_entry *b = entries.data() + slot_begin[idx], *e = entries.data() + slot_begin[idx + 1];
+                    if (b == e) continue;
+                    if (buf.scratch_.size() < static_cast<std::size_t>(e - b)) buf.scratch_.resize(e - b);
+                    if (!INLINE_ENTRIES) worker.data_pool_.Reserve(e - b);
+                    // the input is read in hash order, so bring this slot's share in first
+                    for (const build_entry *it = b; it != e; ++it) NEATLIB_PREFETCH(std::addressof(first[it->pos_]));
+                    try {
+                        worker.build_slot(root_node_.arr_[idx], b, e, 1, first, buf, false);
+                    } catch (...) {
+                        // the other threads stop after their current slot
+                        next_slot = ROOT_ARRAY_SIZE;
+                        throw;
+                    }
+                }
+            });
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto &worker : workers) adopt_nodes(*worker);
+        root_node_.count_ = 0;
+        for (const slot &s : root_node_.arr_) root_node_.count_ += s.type() != EMPTY_NODE;
+        if (error) std::rethrow_exception(error);
     }
 
     bool Insert(const Key &key, const T &mapped) {
-        locator locator_(*this, key, mapped);
-        if (locator_.loc_ref_ == nullptr)
-            return false;
-        assert(key_equal_(locator_.key(), key));
-        assert(key_equal_(locator_.value().second, mapped));
-        ++size_;
-        return true;
+        return insert_entry(key, key, mapped).second;
+    }
+
+    // The Emplace family returns the entry with the key and whether it was
+    // inserted by this call; the pointer stays valid until the next Insert
+    // or Remove.
+
+    // Constructs value_type from args, and keeps it if its key is not there.
+    template<typename... Args>
+    std::pair<value_type *, bool> Emplace(Args &&... args) {
+        value_type value(std::forward<Args>(args)...);
+        return insert_entry(value.first, std::move(value));
+    }
+
+    // Constructs the mapped value from args in place, only when key is not there.
+    template<typename... Args>
+    std::pair<value_type *, bool> TryEmplace(const Key &key, Args &&... args) {
+        return insert_entry(key, std::piecewise_construct, std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    // key is only moved from when it gets inserted
+    template<typename... Args>
+    std::pair<value_type *, bool> TryEmplace(Key &&key, Args &&... args) {
+        return insert_entry(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<typename M>
+    std::pair<value_type *, bool> InsertOrAssign(const Key &key, M &&mapped) {
+        auto ret = TryEmplace(key, std::forward<M>(mapped));
+        if (!ret.second) ret.first->second = std::forward<M>(mapped);
+        return ret;
+    }
+
+    template<typename M>
+    std::pair<value_type *, bool> InsertOrAssign(Key &&key, M &&mapped) {
+        auto ret = TryEmplace(std::move(key), std::forward<M>(mapped));
+        if (!ret.second) ret.first->second = std::forward<M>(mapped);
+        return ret;
     }
 
     std::pair<const Key, T> Get(const Key &key) {
-        locator locator_(*this, key);
-        if (locator_.loc_ref_ == nullptr)
+        const value_type *entry = find_entry(key);
+        if (entry == nullptr)
             throw std::out_of_range("No Element Found");
-        assert(key_equal_(locator_.key(), key));
-        return locator_.value();
+        return *entry;
+    }
+
+    // Heterogeneous lookup: when Hash and KeyEqual both declare
+    // is_transparent, every lookup below also takes a key-like K (a
+    // const char * or std::string_view for std::string keys under
+    // StringHash and std::equal_to<>) and hashes and compares it as it is,
+    // so no temporary Key is built. Hash must give k and Key(k) the same hash.
+    template<typename K, typename = transparent_key<K>>
+    std::pair<const Key, T> Get(const K &key) {
+        const value_type *entry = find_entry(key);
+        if (entry == nullptr)
+            throw std::out_of_range("No Element Found");
+        return *entry;
     }
 
     std::shared_ptr<std::pair<const Key, T>> Find(const Key &key) {
-        locator locator_(*this, key);
-        if (locator_.loc_ref_ == nullptr)
+        const value_type *entry = find_entry(key);
+        if (entry == nullptr)
+            return nullptr;
+        return std::make_shared<std::pair<const Key, T>>(*entry);
+    }
+
+    template<typename K, typename = transparent_key<K>>
+    std::shared_ptr<std::pair<const Key, T>> Find(const K &key) {
+        const value_type *entry = find_entry(key);
+        if (entry == nullptr)
             return nullptr;
-        assert(key_equal_(locator_.key(), key));
-        return std::make_shared<std::pair<const Key, T>>(locator_.value());
+        return std::make_shared<std::pair<const Key, T>>(*entry);
+    }
+
+    // The mapped value of key, or nullptr. Neither allocates nor throws on
+    // a miss (unless Hash or KeyEqual do). The pointer stays valid until the
+    // next Insert or Remove.
+    T *FindPtr(const Key &key) noexcept(NOTHROW_LOOKUP) {
+        const value_type *entry = find_entry(key);
+        return entry == nullptr ? nullptr : &const_cast<value_type *>(entry)->second;
+    }
+
+    const T *FindPtr(const Key &key) const noexcept(NOTHROW_LOOKUP) {
+        const value_type *entry = find_entry(key);
+        return entry == nullptr ? nullptr : &entry->second;
+    }
+
+    template<typename K, typename = transparent_key<K>>
+    T *FindPtr(const K &key) noexcept(nothrow_lookup<K>::value) {
+        const value_type *entry = find_entry(key);
+        return entry == nullptr ? nullptr : &const_cast<value_type *>(entry)->second;
+    }
+
+    template<typename K, typename = transparent_key<K>>
+    const T *FindPtr(const K &key) const noexcept(nothrow_lookup<K>::value) {
+        const value_type *entry = find_entry(key);
+        return entry == nullptr ? nullptr : &entry->second;
+    }
+
+    bool Contains(const Key &key) const noexcept(NOTHROW_LOOKUP) {
+        return find_entry(key) != nullptr;
+    }
+
+    template<typename K, typename = transparent_key<K>>
+    bool Contains(const K &key) const noexcept(nothrow_lookup<K>::value) {
+        return find_entry(key) != nullptr;
+    }
+
+    // Looks up n keys at once: out[i] points at the entry of keys[i], or is
+    // nullptr when there is none. Pointers stay valid until the next Insert
+    // or Remove. Each group of up to BATCH_GROUP keys is hashed at once by
+    // HashBatch, then their walks advance one level at a time, and every
+    // array part (and node, without inline entries) a walk reads next is
+    // prefetched before any of them is touched, so the cache misses of the
+    // whole group overlap instead of queueing up behind each other. A walk
+    // learns the kind of a child array from its parent slot, so it
+    // prefetches the slot of a full child, or all of a node4, on its way
+    // down; a node16 or node48 costs a level a second round trip, but
+    // those of the whole group still overlap. Prefetching all of a node16
+    // up front measured slower, the extra lines crowd out the group's
+    // other misses.
+    // Returns the number of keys found. keys may hold any K a heterogeneous
+    // lookup takes instead of Key.
+    template<typename K, typename = batch_key<K>>
+    std::size_t FindBatch(const K *keys, std::size_t n, const value_type **out) const {
+        std::size_t found = 0;
+        std::size_t hash[BATCH_GROUP];
+        const array_node *arr[BATCH_GROUP];
+        node_kind kind[BATCH_GROUP];
+        const slot *next[BATCH_GROUP];
+        for (std::size_t base = 0; base < n; base += BATCH_GROUP) {
+            std::size_t group = n - base < BATCH_GROUP ? n - base : BATCH_GROUP;
+            std::size_t active = group;
+            HashBatch(hasher_, keys + base, group, hash);
+            for (std::size_t i = 0; i < group; i++) {
+                arr[i] = &root_node_;
+                kind[i] = NODE_ROOT;
+                next[i] = probe_child(arr[i], NODE_ROOT, level_hash(hash[i], 0));
+                NEATLIB_PREFETCH(next[i]);
+                out[base + i] = nullptr;
+            }
+            // some walk has to find its slot in a compact array
+            bool compact = false;
+            for (std::size_t level = 0; active > 0 && level < MAX_LEVEL; level++) {
+                for (std::size_t i = 0; compact && i < group; i++) {
+                    if (arr[i] == nullptr || kind[i] >= NODE_FULL) continue;
+                    next[i] = probe_child(arr[i], kind[i], level_hash(hash[i], level));
+                    if (next[i] != nullptr && kind[i] != NODE4) NEATLIB_PREFETCH(next[i]);
+                }
+                compact = false;
+                if (!INLINE_ENTRIES) {
+                    for (std::size_t i = 0; i < group; i++)
+                        if (arr[i] != nullptr && next[i] != nullptr) next[i]->prefetch();
+                }
+                for (std::size_t i = 0; i < group; i++) {
+                    if (arr[i] == nullptr) continue;
+                    const slot *s = next[i];
+                    if (s != nullptr && s->type() == ARRAY_NODE) {
+                        arr[i] = s->child();
+                        kind[i] = s->child_kind();
+                        std::size_t idx = level_hash(hash[i], level + 1);
+                        if (kind[i] >= NODE_FULL) {
+                            next[i] = probe_child(arr[i], kind[i], idx);
+                            NEATLIB_PREFETCH(next[i]);
+                        } else {
+                            prefetch_child(arr[i], kind[i], idx);
+                            compact = true;
+                        }
+                        continue;
+                    }
+                    const value_type *entry = nullptr;
+                    if (s != nullptr && s->type() == DATA_NODE && s->matches(*this, hash[i], keys[base + i]))
+                        entry = &s->value();
+                    else if (s != nullptr && s->type() == BUCKET_NODE && s->bucket()->hash_ == hash[i])
+                        entry = entry_of(find_in_bucket(s->bucket(), keys[base + i]));
+                    if (entry != nullptr) {
+                        out[base + i] = entry;
+                        ++found;
+                    }
+                    arr[i] = nullptr;
+                    --active;
+                }
+            }
+        }
+        return found;
+    }
+
+    // FindBatch copying the mapped values: out[i] is assigned for every key
+    // that is present, found[i] (when given) tells which ones were.
+    template<typename K, typename = batch_key<K>>
+    std::size_t GetBatch(const K *keys, std::size_t n, T *out, bool *found = nullptr) const {
+        const value_type *entries[BATCH_GROUP];
+        std::size_t ret = 0;
+        for (std::size_t base = 0; base < n; base += BATCH_GROUP) {
+            std::size_t group = n - base < BATCH_GROUP ? n - base : BATCH_GROUP;
+            ret += FindBatch(keys + base, group, entries);
+            for (std::size_t i = 0; i < group; i++) {
+                if (entries[i] != nullptr) out[base + i] = entries[i]->second;
+                if (found != nullptr) found[base + i] = entries[i] != nullptr;
+            }
+        }
+        return ret;
     }
 
     bool Remove(const Key &key) {
-        locator locator_(*this, key);
-        if (locator_.loc_ref_ == nullptr)
+        return remove_entry(key);
+    }
+
+    template<typename K, typename = transparent_key<K>>
+    bool Remove(const K &key) {
+        return remove_entry(key);
+    }
+
+    bool Update(const Key &key, const T &new_mapped) {
+        T *mapped = FindPtr(key);
+        if (mapped == nullptr)
             return false;
-        locator_.loc_ref_->reset(nullptr);
-        --size_;
+        *mapped = new_mapped;
         return true;
     }
 
-    bool Update(const Key &key, const T &new_mapped) {
-        locator locator_(*this, key);
-        if (locator_.loc_ref_ == nullptr)
+    template<typename K, typename = transparent_key<K>>
+    bool Update(const K &key, const T &new_mapped) {
+        T *mapped = FindPtr(key);
+        if (mapped == nullptr)
             return false;
-        auto dn = static_cast<data_node *>(locator_.loc_ref_->get());
-        dn->data_.second = new_mapped;
+        *mapped = new_mapped;
         return true;
     }
 
@@ -271,15 +1752,165 @@ public:
         return size_;
     }
 
+    iterator begin() {
+        return iterator(&root_node_);
+    }
+
+    iterator end() {
+        return iterator();
+    }
+
+    const_iterator begin() const {
+        return const_iterator(&root_node_);
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    const_iterator cbegin() const {
+        return begin();
+    }
+
+    const_iterator cend() const {
+        return end();
+    }
+
+    // Read only view of a snapshot file, see OpenSnapshot().
+    class snapshot {
+    public:
+        snapshot(snapshot &&) = default;
+
+        snapshot &operator=(snapshot &&) = default;
+
+        const T *FindPtr(const Key &key) const {
+            const snapshot_entry *entry = find(key);
+            return entry == nullptr ? nullptr : &entry->mapped_;
+        }
+
+        bool Contains(const Key &key) const {
+            return find(key) != nullptr;
+        }
+
+        std::pair<const Key, T> Get(const Key &key) const {
+            const snapshot_entry *entry = find(key);
+            if (entry == nullptr)
+                throw std::out_of_range("No Element Found");
+            return {entry->key_, entry->mapped_};
+        }
+
+        std::size_t Size() const {
+            return file_.Header().size_;
+        }
+
+        // size of the mapping, not what is resident
+        std::size_t Bytes() const {
+            return file_.Bytes();
+        }
+
+    private:
+        friend class BasicHashTable;
+
+        snapshot(const std::string &path, const Hash &hash, const KeyEqual &equal) :
+                file_(path, snapshot_header(hash)), hasher_(hash), key_equal_(equal) {}
+
+        const snapshot_entry *find(const Key &key) const {
+            std::size_t hash = hasher_(key);
+            uint64_t ref = file_.Header().root_;
+            std::size_t max_level = file_.Header().max_level_;
+            for (std::size_t level = 0;; level++) {
+                if (SnapshotRef::Tag(ref) == SnapshotRef::kEntry) {
+                    const snapshot_entry *entry = file_.At<snapshot_entry>(ref);
+                    return entry->hash_ == hash && key_equal_(entry->key_, key) ? entry : nullptr;
+                }
+                if (SnapshotRef::Tag(ref) == SnapshotRef::kBucket) {
+                    auto bucket = file_.At<char>(ref);
+                    auto entry = reinterpret_cast<const snapshot_entry *>(bucket + SNAPSHOT_ALIGN);
+                    std::size_t count = reinterpret_cast<const snapshot_bucket *>(bucket)->count_;
+                    if (entry->hash_ != hash) return nullptr;
+                    for (std::size_t i = 0; i < count; i++)
+                        if (key_equal_(entry[i].key_, key)) return &entry[i];
+                    return nullptr;
+                }
+                // deeper than any table goes only in a damaged file
+                if (SnapshotRef::Tag(ref) != SnapshotRef::kArray || level == max_level) return nullptr;
+                ref = child(file_.At<snapshot_array>(ref), level_hash(hash, level));
+            }
+        }
+
+        // reference of the child at level hash idx, SnapshotRef::kEmpty if none
+        static uint64_t child(const snapshot_array *arr, std::size_t idx) {
+            auto body = reinterpret_cast<const char *>(arr) + sizeof(snapshot_array);
+            if (arr->kind_ >= NODE_FULL)
+                return reinterpret_cast<const uint64_t *>(body)[idx];
+            auto keys = reinterpret_cast<const child_index *>(body);
+            auto refs = reinterpret_cast<const uint64_t *>(body + (arr->count_ * sizeof(child_index) + 7) / 8 * 8);
+            for (uint32_t i = 0; i < arr->count_; i++)
+                if (keys[i] == idx) return refs[i];
+            return SnapshotRef::kEmpty;
+        }
+
+        MappedSnapshot file_;
+        Hash hasher_;
+        KeyEqual key_equal_;
+    };
+
+    // Writes the table to path as a snapshot, which OpenSnapshot() maps
+    // back for lookups without rebuilding anything. Records are laid out
+    // like the live trie, compact arrays included, and refer to each other
+    // by file offset. Needs trivially copyable Key and T, the file is only
+    // good on machines with the same byte order and type sizes. The file is
+    // written next to path and renamed over it when complete, so processes
+    // mapping an older snapshot at path keep their view. Throws
+    // std::runtime_error when the file can not be written.
+    void SaveSnapshot(const std::string &path) const {
+        static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+                      "snapshots need trivially copyable keys and values");
+        SnapshotWriter out(path, SNAPSHOT_ALIGN);
+        SnapshotHeader header = snapshot_header(hasher_);
+        header.root_ = save_array(out, root_node_);
+        header.size_ = size_;
+        header.max_level_ = MAX_LEVEL;
+        out.Finish(header);
+    }
+
+    // Maps a file from SaveSnapshot() of a table of the same type. Pages are
+    // read in as lookups touch them and shared with every process mapping
+    // the file. Throws std::runtime_error when the file can not be mapped or
+    // does not look like such a snapshot.
+    static snapshot OpenSnapshot(const std::string &path, const Hash &hash = Hash(),
+                                 const KeyEqual &equal = KeyEqual()) {
+        static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+                      "snapshots need trivially copyable keys and values");
+        return snapshot(path, hash, equal);
+    }
+
+    // Walks the whole trie, O(number of nodes).
+    TrieStats Stats() const {
+        TrieStats stats;
+        collect_stats(root_node_, 0, stats);
+        // free slots of the pools, i.e. chunk memory not holding a live node
+        stats.pool_bytes = data_pool_.FreeCount() * data_node_pool::SlotBytes() +
+                           bucket_pool_.FreeCount() * bucket_node_pool::SlotBytes() +
+                           node4_pool_.FreeCount() * node4_pool::SlotBytes() +
+                           node16_pool_.FreeCount() * node16_pool::SlotBytes() +
+                           node48_pool_.FreeCount() * node48_pool::SlotBytes() +
+                           full_pool_.FreeCount() * full_node_pool::SlotBytes();
+        return stats;
+    }
+
 
 private:
-    array_node root_node_;
-    array_node_pool pool_;
+    data_node_pool data_pool_;
+    bucket_node_pool bucket_pool_;
+    node4_pool node4_pool_;
+    node16_pool node16_pool_;
+    node48_pool node48_pool_;
+    full_node_pool full_pool_;
+    root_node root_node_;
     KeyEqual key_equal_;
     Hash hasher_;
     std::size_t size_ = 0;
-    std::size_t max_level_ = 0;
-    std::size_t max_ = 0;
 
 };
 
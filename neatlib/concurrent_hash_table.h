@@ -15,6 +15,7 @@
 #include <type_traits>
 #include <cassert>
 #include "util.h"
+#include "trie_stats.h"
 
 namespace neatlib {
 
@@ -287,6 +288,20 @@ private:
         }
     };
 
+    static void collect_stats(const array_node &arr, std::size_t level, TrieStats &stats) {
+        std::size_t used = 0;
+        for (const atomic_shared_ptr<node> &slot : arr.arr_) {
+            shared_ptr<node> child = slot.load();
+            if (!child.get()) continue;
+            ++used;
+            if (child->type_ == node_type::DATA_NODE)
+                stats.RecordData(level);
+            else
+                collect_stats(*static_cast<const array_node *>(child.get()), level + 1, stats);
+        }
+        stats.RecordArray(level, used, ARRAY_SIZE);
+    }
+
 public:
     ConcurrentHashTable() : size_(0) {
         std::size_t m = 1, num = ARRAY_SIZE, level = 1;
@@ -356,6 +371,28 @@ public:
         return size_.load();
     }
 
+    // Walks the trie while other threads may keep modifying it, so the
+    // result is only a snapshot. Bytes do not include the shared_ptr
+    // control blocks.
+    TrieStats Stats() const {
+        TrieStats stats;
+        std::size_t used = 0;
+        for (const atomic_shared_ptr<node> &slot : root_arr_) {
+            shared_ptr<node> child = slot.load();
+            if (!child.get()) continue;
+            ++used;
+            if (child->type_ == node_type::DATA_NODE)
+                stats.RecordData(0);
+            else
+                collect_stats(*static_cast<const array_node *>(child.get()), 1, stats);
+        }
+        stats.RecordArray(0, used, ROOT_ARRAY_SIZE);
+        stats.node_bytes = sizeof(root_arr_) +
+                           (stats.array_node_count - 1) * sizeof(array_node) +
+                           stats.data_node_count * sizeof(data_node);
+        return stats;
+    }
+
 private:
     std::array<atomic_shared_ptr<node>, ROOT_ARRAY_SIZE> root_arr_;
     Hash hasher_;
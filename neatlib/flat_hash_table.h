@@ -0,0 +1,355 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_FLAT_HASH_TABLE_H
+#define NEATLIB_FLAT_HASH_TABLE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <functional>
+#include <utility>
+#include "util.h"
+#include "hash_policy.h"
+#include "trie_stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NEATLIB_FLAT_HASH_TABLE_SSE2 1
+#endif
+
+namespace neatlib {
+
+// Sequential open addressing table with the interface of BasicHashTable, so
+// either can be picked at the type level. Every slot has a control byte that
+// is empty, deleted, or the low 7 bits of the key's hash; a lookup compares
+// 16 control bytes at a time (SSE2 when available) and only touches the slots
+// whose byte matches. Probing walks groups of 16 in triangular steps.
+template<class Key, class T, class Hash = std::hash<Key>,
+        class KeyEqual = std::equal_to<Key>,
+        class Allocator = std::allocator<std::pair<const Key, T>>>
+class FlatHashTable {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+
+private:
+    using ctrl_t = int8_t;
+
+    constexpr static ctrl_t EMPTY = -128;
+    constexpr static ctrl_t DELETED = -2;
+    constexpr static std::size_t GROUP_WIDTH = 16;
+    constexpr static std::size_t MIN_CAPACITY = GROUP_WIDTH;
+    constexpr static std::size_t npos = static_cast<std::size_t>(-1);
+
+    using slot_type = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+    using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<slot_type>;
+    using ctrl_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ctrl_t>;
+
+    // A bit per control byte of a group, lowest bit first.
+    struct bit_mask {
+        uint32_t mask_;
+
+        explicit operator bool() const { return mask_ != 0; }
+
+        std::size_t lowest() const { return static_cast<std::size_t>(__builtin_ctz(mask_)); }
+
+        void clear_lowest() { mask_ &= mask_ - 1; }
+
+        std::size_t trailing_zeros() const {
+            return mask_ ? lowest() : GROUP_WIDTH;
+        }
+
+        std::size_t leading_zeros() const {
+            return mask_ ? static_cast<std::size_t>(__builtin_clz(mask_)) - (32 - GROUP_WIDTH) : GROUP_WIDTH;
+        }
+    };
+
+    struct group {
+#ifdef NEATLIB_FLAT_HASH_TABLE_SSE2
+        __m128i ctrl_;
+
+        explicit group(const ctrl_t *pos) :
+                ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))) {}
+
+        bit_mask match(ctrl_t h2) const {
+            return bit_mask{static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)))};
+        }
+
+        bit_mask match_empty() const {
+            return match(EMPTY);
+        }
+
+        // empty and deleted are the only negative bytes below -1
+        bit_mask match_empty_or_deleted() const {
+            return bit_mask{static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl_)))};
+        }
+#else
+        const ctrl_t *ctrl_;
+
+        explicit group(const ctrl_t *pos) : ctrl_(pos) {}
+
+        bit_mask match(ctrl_t h2) const {
+            uint32_t mask = 0;
+            for (std::size_t i = 0; i < GROUP_WIDTH; i++)
+                if (ctrl_[i] == h2) mask |= 1u << i;
+            return bit_mask{mask};
+        }
+
+        bit_mask match_empty() const {
+            return match(EMPTY);
+        }
+
+        bit_mask match_empty_or_deleted() const {
+            uint32_t mask = 0;
+            for (std::size_t i = 0; i < GROUP_WIDTH; i++)
+                if (ctrl_[i] < -1) mask |= 1u << i;
+            return bit_mask{mask};
+        }
+#endif
+    };
+
+    // std::hash of an integer is the identity on common standard libraries,
+    // so the bits are mixed before splitting them into the probe start (h1)
+    // and the control byte (h2)
+    static std::size_t mix(std::size_t hash) {
+        return static_cast<std::size_t>(util::mix64(hash));
+    }
+
+    static std::size_t h1(std::size_t hash) { return hash >> 7; }
+
+    static ctrl_t h2(std::size_t hash) { return static_cast<ctrl_t>(hash & 0x7F); }
+
+    static bool is_full(ctrl_t c) { return c >= 0; }
+
+    // keep at least one slot in eight empty so every probe ends
+    static std::size_t max_load(std::size_t capacity) { return capacity - capacity / 8; }
+
+    value_type *slot(std::size_t i) { return reinterpret_cast<value_type *>(&slots_[i]); }
+
+    const value_type *slot(std::size_t i) const { return reinterpret_cast<const value_type *>(&slots_[i]); }
+
+    // The first GROUP_WIDTH control bytes are mirrored past the end, so a
+    // group load starting anywhere in the table never needs to wrap.
+    void set_ctrl(std::size_t i, ctrl_t c) {
+        ctrl_[i] = c;
+        if (i < GROUP_WIDTH) ctrl_[capacity_ + i] = c;
+    }
+
+    std::size_t find_index(const Key &key) const {
+        if (capacity_ == 0) return npos;
+        std::size_t hash = mix(hasher_(key));
+        std::size_t mask = capacity_ - 1;
+        std::size_t pos = h1(hash) & mask;
+        for (std::size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+            group g(ctrl_ + pos);
+            for (bit_mask m = g.match(h2(hash)); m; m.clear_lowest()) {
+                std::size_t i = (pos + m.lowest()) & mask;
+                if (key_equal_(slot(i)->first, key)) return i;
+            }
+            if (g.match_empty()) return npos;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    // first empty or deleted slot on the probe sequence of hash
+    std::size_t find_free(std::size_t hash) const {
+        std::size_t mask = capacity_ - 1;
+        std::size_t pos = h1(hash) & mask;
+        for (std::size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+            bit_mask m = group(ctrl_ + pos).match_empty_or_deleted();
+            if (m) return (pos + m.lowest()) & mask;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    void allocate(std::size_t capacity) {
+        capacity_ = capacity;
+        slots_ = std::allocator_traits<slot_allocator>::allocate(slot_alloc_, capacity);
+        ctrl_ = std::allocator_traits<ctrl_allocator>::allocate(ctrl_alloc_, capacity + GROUP_WIDTH);
+        std::memset(ctrl_, EMPTY, capacity + GROUP_WIDTH);
+        growth_left_ = max_load(capacity);
+    }
+
+    void deallocate() {
+        if (capacity_ == 0) return;
+        for (std::size_t i = 0; i < capacity_; i++)
+            if (is_full(ctrl_[i])) slot(i)->~value_type();
+        std::allocator_traits<slot_allocator>::deallocate(slot_alloc_, slots_, capacity_);
+        std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc_, ctrl_, capacity_ + GROUP_WIDTH);
+        slots_ = nullptr;
+        ctrl_ = nullptr;
+        capacity_ = 0;
+    }
+
+    void rehash(std::size_t new_capacity) {
+        slot_type *old_slots = slots_;
+        ctrl_t *old_ctrl = ctrl_;
+        std::size_t old_capacity = capacity_;
+        allocate(new_capacity);
+        for (std::size_t i = 0; i < old_capacity; i++) {
+            if (!is_full(old_ctrl[i])) continue;
+            value_type *old = reinterpret_cast<value_type *>(&old_slots[i]);
+            std::size_t hash = mix(hasher_(old->first));
+            std::size_t target = find_free(hash);
+            new(slot(target)) value_type(std::move(*old));
+            old->~value_type();
+            set_ctrl(target, h2(hash));
+        }
+        growth_left_ -= size_;
+        if (old_capacity == 0) return;
+        std::allocator_traits<slot_allocator>::deallocate(slot_alloc_, old_slots, old_capacity);
+        std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc_, old_ctrl, old_capacity + GROUP_WIDTH);
+    }
+
+    // Out of empty slots: tombstones are dropped by rehashing in place when
+    // they are what fills the table, otherwise the table doubles.
+    void make_room() {
+        if (capacity_ == 0)
+            rehash(MIN_CAPACITY);
+        else if (size_ < max_load(capacity_) / 2)
+            rehash(capacity_);
+        else
+            rehash(capacity_ * 2);
+    }
+
+    static std::size_t capacity_for(std::size_t count) {
+        std::size_t capacity = MIN_CAPACITY;
+        while (max_load(capacity) < count) capacity *= 2;
+        return capacity;
+    }
+
+public:
+    FlatHashTable() = default;
+
+    explicit FlatHashTable(std::size_t capacity) : FlatHashTable() {
+        Reserve(capacity);
+    }
+
+    FlatHashTable(const FlatHashTable &) = delete;
+
+    FlatHashTable &operator=(const FlatHashTable &) = delete;
+
+    ~FlatHashTable() {
+        deallocate();
+    }
+
+    void Reserve(std::size_t new_cap) {
+        if (new_cap <= size_ + growth_left_) return;
+        rehash(capacity_for(new_cap));
+    }
+
+    bool Insert(const Key &key, const T &mapped) {
+        if (find_index(key) != npos)
+            return false;
+        std::size_t hash = mix(hasher_(key));
+        if (capacity_ == 0) make_room();
+        std::size_t i = find_free(hash);
+        if (ctrl_[i] == EMPTY && growth_left_ == 0) {
+            make_room();
+            i = find_free(hash);
+        }
+        if (ctrl_[i] == EMPTY) --growth_left_;
+        new(slot(i)) value_type(key, mapped);
+        set_ctrl(i, h2(hash));
+        ++size_;
+        return true;
+    }
+
+    std::pair<const Key, T> Get(const Key &key) {
+        std::size_t i = find_index(key);
+        if (i == npos)
+            throw std::out_of_range("No Element Found");
+        return *slot(i);
+    }
+
+    std::shared_ptr<std::pair<const Key, T>> Find(const Key &key) {
+        std::size_t i = find_index(key);
+        if (i == npos)
+            return nullptr;
+        return std::make_shared<std::pair<const Key, T>>(*slot(i));
+    }
+
+    // The mapped value of key, or nullptr, without allocating or throwing.
+    T *FindPtr(const Key &key) {
+        std::size_t i = find_index(key);
+        return i == npos ? nullptr : &slot(i)->second;
+    }
+
+    const T *FindPtr(const Key &key) const {
+        std::size_t i = find_index(key);
+        return i == npos ? nullptr : &slot(i)->second;
+    }
+
+    bool Contains(const Key &key) const {
+        return find_index(key) != npos;
+    }
+
+    // A slot can go back to empty only when no probe ever walked past it,
+    // i.e. it is not inside a run of GROUP_WIDTH full or deleted slots.
+    bool Remove(const Key &key) {
+        std::size_t i = find_index(key);
+        if (i == npos)
+            return false;
+        slot(i)->~value_type();
+        std::size_t mask = capacity_ - 1;
+        bit_mask empty_before = group(ctrl_ + ((i - GROUP_WIDTH) & mask)).match_empty();
+        bit_mask empty_after = group(ctrl_ + i).match_empty();
+        bool was_never_full = empty_before.leading_zeros() + empty_after.trailing_zeros() < GROUP_WIDTH;
+        set_ctrl(i, was_never_full ? EMPTY : DELETED);
+        if (was_never_full) ++growth_left_;
+        --size_;
+        return true;
+    }
+
+    bool Update(const Key &key, const T &new_mapped) {
+        std::size_t i = find_index(key);
+        if (i == npos)
+            return false;
+        slot(i)->second = new_mapped;
+        return true;
+    }
+
+    std::size_t Size() const {
+        return size_;
+    }
+
+    std::size_t Capacity() const {
+        return capacity_;
+    }
+
+    // The slot array reported as a single level 0 array node.
+    TrieStats Stats() const {
+        TrieStats stats;
+        stats.RecordArray(0, size_, capacity_ ? capacity_ : 1);
+        stats.depth_histogram.assign(1, size_);
+        stats.data_node_count = size_;
+        stats.node_bytes = capacity_ ? capacity_ * sizeof(slot_type) + capacity_ + GROUP_WIDTH : 0;
+        return stats;
+    }
+
+private:
+    slot_type *slots_ = nullptr;
+    ctrl_t *ctrl_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+    std::size_t growth_left_ = 0;
+    slot_allocator slot_alloc_;
+    ctrl_allocator ctrl_alloc_;
+    KeyEqual key_equal_;
+    Hash hasher_;
+};
+
+} // namespace neatlib
+
+#endif //NEATLIB_FLAT_HASH_TABLE_H
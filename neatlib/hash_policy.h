@@ -0,0 +1,213 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_HASH_POLICY_H
+#define NEATLIB_HASH_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+#define NEATLIB_HAS_STRING_VIEW 1
+#endif
+
+#if defined(__AVX512DQ__)
+#include <immintrin.h>
+#define NEATLIB_HASH_AVX512 1
+#endif
+
+namespace neatlib {
+
+namespace util {
+
+// Multiply-xorshift finalizer (the first half of MurmurHash3's fmix64):
+// every input bit reaches the low bits the tries slice first.
+inline uint64_t mix64(uint64_t h) noexcept {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 64 x 64 -> 128 bit multiply, low half into a and high half into b.
+inline void wy_mum(uint64_t &a, uint64_t &b) noexcept {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = a;
+    r *= b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline uint64_t wy_mix(uint64_t a, uint64_t b) noexcept {
+    wy_mum(a, b);
+    return a ^ b;
+}
+
+inline uint64_t wy_read8(const uint8_t *p) noexcept {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t wy_read4(const uint8_t *p) noexcept {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// The byte hash of wyhash (final version 4): 16 bytes per multiply, 48 per
+// round on long inputs, and short inputs read without a loop. The result
+// depends on the byte order of the machine.
+inline uint64_t hash_bytes(const void *data, std::size_t len, uint64_t seed = 0) noexcept {
+    constexpr uint64_t p0 = 0xA0761D6478BD642FULL, p1 = 0xE7037ED1A0B428DBULL;
+    constexpr uint64_t p2 = 0x8EBC6AF09C88C6E3ULL, p3 = 0x589965CC75374CC3ULL;
+    auto p = static_cast<const uint8_t *>(data);
+    seed ^= wy_mix(seed ^ p0, p1);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            std::size_t mid = (len >> 3) << 2;
+            a = (wy_read4(p) << 32) | wy_read4(p + mid);
+            b = (wy_read4(p + len - 4) << 32) | wy_read4(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        std::size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = wy_mix(wy_read8(p) ^ p1, wy_read8(p + 8) ^ seed);
+                see1 = wy_mix(wy_read8(p + 16) ^ p2, wy_read8(p + 24) ^ see1);
+                see2 = wy_mix(wy_read8(p + 32) ^ p3, wy_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wy_mix(wy_read8(p) ^ p1, wy_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = wy_read8(p + i - 16);
+        b = wy_read8(p + i - 8);
+    }
+    a ^= p1;
+    b ^= seed;
+    wy_mum(a, b);
+    return wy_mix(a ^ p0 ^ len, b ^ p1);
+}
+
+} // namespace util
+
+// Hash policies for the tables. std::hash of an integer is the identity on
+// the common standard libraries, so clustered keys (ids handed out in
+// blocks, multiples of a page size) share their low bits and pile up in
+// a few deep paths of a trie. These spread every bit of the key over the
+// whole hash.
+
+// Integers, enums and pointers are mixed directly, anything else mixes
+// what std::hash gives.
+template<typename Key, typename = void>
+struct MixHash {
+    std::size_t operator()(const Key &key) const noexcept(noexcept(std::hash<Key>()(key))) {
+        return static_cast<std::size_t>(util::mix64(std::hash<Key>()(key)));
+    }
+};
+
+template<typename Key>
+struct MixHash<Key, typename std::enable_if<std::is_integral<Key>::value || std::is_enum<Key>::value ||
+                                            std::is_pointer<Key>::value>::type> {
+    std::size_t operator()(const Key &key) const noexcept {
+        return static_cast<std::size_t>(util::mix64(to_bits(key)));
+    }
+
+private:
+    template<typename K>
+    static typename std::enable_if<!std::is_pointer<K>::value, uint64_t>::type to_bits(const K &key) {
+        return static_cast<uint64_t>(key);
+    }
+
+    template<typename K>
+    static typename std::enable_if<std::is_pointer<K>::value, uint64_t>::type to_bits(const K &key) {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+    }
+};
+
+// wyhash-style string hash; on libstdc++ it beats std::hash<std::string>
+// (murmur2) by 1.3 to 1.5 times from about 24 bytes on. It is transparent:
+// a C string (and a std::string_view from C++17 on) hashes like the
+// std::string with the same characters, so with std::equal_to<> a table
+// of std::string keys looks them up without building a std::string.
+struct StringHash {
+    using is_transparent = void;
+
+    std::size_t operator()(const std::string &key) const noexcept {
+        return static_cast<std::size_t>(util::hash_bytes(key.data(), key.size()));
+    }
+
+    std::size_t operator()(const char *key) const noexcept {
+        return static_cast<std::size_t>(util::hash_bytes(key, std::strlen(key)));
+    }
+
+#ifdef NEATLIB_HAS_STRING_VIEW
+    std::size_t operator()(std::string_view key) const noexcept {
+        return static_cast<std::size_t>(util::hash_bytes(key.data(), key.size()));
+    }
+#endif
+};
+
+// The policy neatlib picks for Key: StringHash for std::string, MixHash
+// for everything else.
+template<typename Key>
+using FastHash = typename std::conditional<std::is_same<Key, std::string>::value, StringHash, MixHash<Key>>::type;
+
+// Hashes n keys into out, each the same value hash(keys[i]) gives. The
+// batch lookups hash a whole group this way before walking any of it.
+template<typename Hash, typename Key>
+void HashBatch(const Hash &hash, const Key *keys, std::size_t n, std::size_t *out) {
+    for (std::size_t i = 0; i < n; i++) out[i] = hash(keys[i]);
+}
+
+// 64 bit integers under MixHash, 8 lanes at a time where AVX-512DQ has the
+// 64 bit multiply; otherwise the loop has no dependency between keys and
+// the multiplies of neighbouring keys overlap.
+template<typename Key>
+typename std::enable_if<std::is_integral<Key>::value && sizeof(Key) == 8 && sizeof(std::size_t) == 8>::type
+HashBatch(const MixHash<Key> &, const Key *keys, std::size_t n, std::size_t *out) {
+    std::size_t i = 0;
+#ifdef NEATLIB_HASH_AVX512
+    const __m512i mul = _mm512_set1_epi64(static_cast<long long>(0xFF51AFD7ED558CCDULL));
+    for (; i + 8 <= n; i += 8) {
+        __m512i h = _mm512_loadu_si512(keys + i);
+        h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 33));
+        h = _mm512_mullo_epi64(h, mul);
+        h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 33));
+        _mm512_storeu_si512(out + i, h);
+    }
+#endif
+    for (; i < n; i++) out[i] = static_cast<std::size_t>(util::mix64(static_cast<uint64_t>(keys[i])));
+}
+
+} // namespace neatlib
+
+#endif //NEATLIB_HASH_POLICY_H
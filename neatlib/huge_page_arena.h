@@ -0,0 +1,252 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_HUGE_PAGE_ARENA_H
+#define NEATLIB_HUGE_PAGE_ARENA_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace neatlib {
+
+// How a HugePageArena backs its regions.
+enum class HugePages {
+    // MAP_HUGETLB pages while the system has some reserved, otherwise
+    // regular pages marked with madvise(MADV_HUGEPAGE) for transparent
+    // huge pages
+    Auto,
+    // regular pages marked with madvise(MADV_HUGEPAGE) only
+    Transparent,
+    // regular pages marked with madvise(MADV_NOHUGEPAGE), the 4 KB
+    // baseline to compare the others with
+    Off
+};
+
+// Memory for node pools, carved from 2 MB aligned regions so that the
+// nodes of a large table sit on huge pages and a trie walk needs a handful
+// of TLB entries instead of one per node. Where neither kind of huge page
+// can be had (THP disabled, not Linux) the regions are still handed out,
+// backed by whatever pages the system gives. Allocate() is safe to call
+// from several threads at once. Nothing is returned before the arena is
+// destroyed, which suits pools that keep and reuse their own free nodes.
+class HugePageArena {
+private:
+    // the head of every region, its allocations start at HEADER_BYTES
+    struct region {
+        region *next_;
+        void *mapping_;
+        std::size_t mapping_bytes_;
+        std::size_t bytes_;
+        std::atomic<std::size_t> used_;
+    };
+
+    constexpr static std::size_t HEADER_BYTES = (sizeof(region) + 63) / 64 * 64;
+
+    static std::size_t round_up(std::size_t n, std::size_t to) {
+        return (n + to - 1) / to * to;
+    }
+
+    region *init_region(void *mapping, std::size_t mapping_bytes, void *base, std::size_t bytes) {
+        auto r = new(base) region;
+        r->next_ = regions_;
+        r->mapping_ = mapping;
+        r->mapping_bytes_ = mapping_bytes;
+        r->bytes_ = bytes;
+        r->used_.store(HEADER_BYTES, std::memory_order_relaxed);
+        regions_ = r;
+        mapped_bytes_ += bytes;
+        return r;
+    }
+
+    // A new region of at least min_bytes, linked into regions_. Called
+    // with mutex_ held. Throws std::bad_alloc when nothing can be mapped.
+    region *map_region(std::size_t min_bytes) {
+        std::size_t bytes = round_up(min_bytes, REGION_BYTES);
+#ifdef __linux__
+#ifdef MAP_HUGETLB
+        if (mode_ == HugePages::Auto && hugetlb_works_) {
+            void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                hugetlb_bytes_ += bytes;
+                return init_region(p, bytes, p, bytes);
+            }
+            // no reserved huge pages left, do not ask again for every region
+            hugetlb_works_ = false;
+        }
+#endif
+        // map one region more than needed and trim, transparent huge pages
+        // only back 2 MB aligned ranges
+        std::size_t span = bytes + REGION_BYTES;
+        void *p = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        auto raw = reinterpret_cast<uintptr_t>(p);
+        auto base = round_up(raw, REGION_BYTES);
+        std::size_t head = base - raw;
+        if (head > 0) munmap(p, head);
+        if (span - head > bytes) munmap(reinterpret_cast<void *>(base + bytes), span - head - bytes);
+        void *aligned = reinterpret_cast<void *>(base);
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        if (mode_ == HugePages::Off)
+            madvise(aligned, bytes, MADV_NOHUGEPAGE);
+        else if (madvise(aligned, bytes, MADV_HUGEPAGE) == 0)
+            advised_bytes_ += bytes;
+#endif
+        return init_region(aligned, bytes, aligned, bytes);
+#else
+        void *p = std::malloc(bytes + REGION_BYTES);
+        if (p == nullptr) throw std::bad_alloc();
+        void *aligned = reinterpret_cast<void *>(round_up(reinterpret_cast<uintptr_t>(p), REGION_BYTES));
+        return init_region(p, bytes + REGION_BYTES, aligned, bytes);
+#endif
+    }
+
+    static void unmap_region(region *r) {
+        void *mapping = r->mapping_;
+        std::size_t mapping_bytes = r->mapping_bytes_;
+        r->~region();
+#ifdef __linux__
+        munmap(mapping, mapping_bytes);
+#else
+        static_cast<void>(mapping_bytes);
+        std::free(mapping);
+#endif
+    }
+
+public:
+    constexpr static std::size_t REGION_BYTES = 2 * 1024 * 1024;
+    // every allocation is aligned to this much at least
+    constexpr static std::size_t ALIGN = alignof(std::max_align_t);
+
+    explicit HugePageArena(HugePages mode = HugePages::Auto) : mode_(mode) {}
+
+    HugePageArena(const HugePageArena &) = delete;
+
+    HugePageArena &operator=(const HugePageArena &) = delete;
+
+    ~HugePageArena() {
+        while (regions_ != nullptr) {
+            region *r = regions_;
+            regions_ = r->next_;
+            unmap_region(r);
+        }
+    }
+
+    // bytes of uninitialized memory aligned to align. Requests bigger than
+    // a region get a region of their own, the others are bumped off the
+    // current region, and a new one is mapped once it runs out.
+    void *Allocate(std::size_t bytes, std::size_t align = ALIGN) {
+        assert(align != 0 && (align & (align - 1)) == 0);
+        bytes = round_up(bytes == 0 ? 1 : bytes, ALIGN);
+        if (align > ALIGN) bytes += align - ALIGN;
+        for (;;) {
+            region *r = current_.load(std::memory_order_acquire);
+            if (r != nullptr && bytes <= r->bytes_ - HEADER_BYTES) {
+                std::size_t offset = r->used_.fetch_add(bytes, std::memory_order_relaxed);
+                if (offset + bytes <= r->bytes_) {
+                    auto p = reinterpret_cast<uintptr_t>(r) + offset;
+                    return reinterpret_cast<void *>(round_up(p, align));
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (bytes + HEADER_BYTES > REGION_BYTES) {
+                region *own = map_region(bytes + HEADER_BYTES);
+                own->used_.store(own->bytes_, std::memory_order_relaxed);
+                return reinterpret_cast<void *>(round_up(reinterpret_cast<uintptr_t>(own) + HEADER_BYTES, align));
+            }
+            // another thread has mapped the next region meanwhile
+            if (current_.load(std::memory_order_relaxed) != r) continue;
+            current_.store(map_region(REGION_BYTES), std::memory_order_release);
+        }
+    }
+
+    HugePages Mode() const { return mode_; }
+
+    // every byte mapped so far
+    std::size_t MappedBytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return mapped_bytes_;
+    }
+
+    // the part of MappedBytes() on MAP_HUGETLB pages
+    std::size_t HugeTlbBytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hugetlb_bytes_;
+    }
+
+    // the part of MappedBytes() the kernel took madvise(MADV_HUGEPAGE) for;
+    // how much of it is huge is up to khugepaged and the THP settings
+    std::size_t AdvisedBytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return advised_bytes_;
+    }
+
+private:
+    HugePages mode_;
+    std::atomic<region *> current_{nullptr};
+    mutable std::mutex mutex_;
+    region *regions_ = nullptr;
+    bool hugetlb_works_ = true;
+    std::size_t mapped_bytes_ = 0;
+    std::size_t hugetlb_bytes_ = 0;
+    std::size_t advised_bytes_ = 0;
+};
+
+// An allocator over a HugePageArena, for the Allocator parameter of
+// BasicHashTable and LockFreeHashTable. Copies and rebinds share the arena,
+// a default constructed one makes a new arena in HugePages::Auto mode.
+// deallocate() does nothing: the memory goes back when the last allocator
+// sharing the arena is destroyed, together with the table that owns it.
+// The tables keep what they free for reuse (BasicHashTable in its slab
+// pools, LockFreeHashTable in its per-thread DataNode queues and spare
+// arrays), so churn does not grow the arena past the table's peak size.
+template<typename T>
+class HugePageAllocator {
+public:
+    using value_type = T;
+
+    HugePageAllocator() : HugePageAllocator(HugePages::Auto) {}
+
+    explicit HugePageAllocator(HugePages mode) : arena_(std::make_shared<HugePageArena>(mode)) {}
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U> &other) noexcept : arena_(other.arena_) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) noexcept {}
+
+    const HugePageArena &Arena() const { return *arena_; }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U> &other) const noexcept {
+        return arena_ == other.arena_;
+    }
+
+    template<typename U>
+    bool operator!=(const HugePageAllocator<U> &other) const noexcept {
+        return arena_ != other.arena_;
+    }
+
+private:
+    template<typename U> friend class HugePageAllocator;
+
+    std::shared_ptr<HugePageArena> arena_;
+};
+
+} // namespace neatlib
+
+#endif //NEATLIB_HUGE_PAGE_ARENA_H
@@ -0,0 +1,200 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_INSTRUMENTATION_H
+#define NEATLIB_INSTRUMENTATION_H
+
+#include <epoch/faster/thread.h>
+#include <atomic>
+#include <cassert>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace neatlib {
+namespace instrumentation {
+
+enum class OpType {
+    Insert = 0, Get, Update, Remove
+};
+
+constexpr std::size_t kOpCount = 4;
+// log2(ns) buckets, bucket b counts latencies in [2^b, 2^(b+1))
+constexpr std::size_t kLatencyBuckets = 64;
+// deeper levels are folded into the last bucket
+constexpr std::size_t kMaxTrackedLevel = 32;
+
+inline const char *OpName(std::size_t op) {
+    static const char *names[kOpCount] = {"insert", "get", "update", "remove"};
+    return names[op];
+}
+
+// Plain (non-atomic) copy of the counters, produced by merging all threads.
+struct Snapshot {
+    std::array<std::array<uint64_t, kLatencyBuckets>, kOpCount> latency{};
+    std::array<uint64_t, kOpCount> ops{};
+    std::array<uint64_t, kOpCount> fail_limit_hits{};
+    std::array<uint64_t, kMaxTrackedLevel> cas_failures{};
+    std::array<uint64_t, kMaxTrackedLevel + 1> levels_traversed{};
+
+    // upper bound in ns of the bucket holding the p-th percentile
+    uint64_t Percentile(OpType op, double p) const {
+        const auto &h = latency[static_cast<std::size_t>(op)];
+        uint64_t total = ops[static_cast<std::size_t>(op)];
+        if (total == 0) return 0;
+        auto rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (std::size_t b = 0; b < kLatencyBuckets; b++) {
+            seen += h[b];
+            if (seen > rank) return b + 1 < 64 ? (uint64_t(1) << (b + 1)) : UINT64_MAX;
+        }
+        return UINT64_MAX;
+    }
+
+    void Dump(std::ostream &os) const {
+        os << std::left << std::setw(8) << "op" << std::right << std::setw(14) << "count"
+           << std::setw(12) << "fail_limit" << std::setw(12) << "p50(ns)<"
+           << std::setw(12) << "p99(ns)<" << std::setw(12) << "p999(ns)<" << "\n";
+        for (std::size_t op = 0; op < kOpCount; op++) {
+            if (ops[op] == 0) continue;
+            auto type = static_cast<OpType>(op);
+            os << std::left << std::setw(8) << OpName(op) << std::right << std::setw(14) << ops[op]
+               << std::setw(12) << fail_limit_hits[op] << std::setw(12) << Percentile(type, 50)
+               << std::setw(12) << Percentile(type, 99) << std::setw(12) << Percentile(type, 99.9) << "\n";
+        }
+        os << "cas failures per level:";
+        for (std::size_t l = 0; l < kMaxTrackedLevel; l++)
+            if (cas_failures[l]) os << " " << l << ":" << cas_failures[l];
+        os << "\nlevels per lookup:";
+        for (std::size_t l = 0; l <= kMaxTrackedLevel; l++)
+            if (levels_traversed[l]) os << " " << l << ":" << levels_traversed[l];
+        os << "\n";
+    }
+};
+
+// The default policy. Every hook is empty and StartOp does not read the
+// clock, so an uninstrumented table compiles to the same code as before.
+struct None {
+    static constexpr bool kEnabled = false;
+
+    explicit None(std::size_t) {}
+
+    inline uint64_t StartOp() const { return 0; }
+
+    inline void EndOp(OpType, uint64_t) {}
+
+    inline void CasFailure(std::size_t) {}
+
+    inline void LevelsTraversed(std::size_t) {}
+
+    inline void FailLimitHit(OpType) {}
+
+    Snapshot Merge() const { return Snapshot(); }
+
+    void Dump(std::ostream &) const {}
+};
+
+// Per-thread counters indexed by FASTER thread id. Each slot is written only
+// by its owning thread, with relaxed load+store instead of a locked add, and
+// may be read by any thread at any time, so Merge() and Dump() never stop
+// the writers. A merge is not a consistent cut across threads, but every
+// individual counter is exact.
+class Counters {
+private:
+    struct ThreadSlot {
+        std::array<std::array<std::atomic<uint64_t>, kLatencyBuckets>, kOpCount> latency;
+        std::array<std::atomic<uint64_t>, kOpCount> ops;
+        std::array<std::atomic<uint64_t>, kOpCount> fail_limit_hits;
+        std::array<std::atomic<uint64_t>, kMaxTrackedLevel> cas_failures;
+        std::array<std::atomic<uint64_t>, kMaxTrackedLevel + 1> levels_traversed;
+        // keeps the hot counters of neighbouring slots off a shared cache line
+        char padding_[64];
+
+        ThreadSlot() {
+            for (auto &h : latency)
+                for (auto &c : h) c.store(0, std::memory_order_relaxed);
+            for (auto &c : ops) c.store(0, std::memory_order_relaxed);
+            for (auto &c : fail_limit_hits) c.store(0, std::memory_order_relaxed);
+            for (auto &c : cas_failures) c.store(0, std::memory_order_relaxed);
+            for (auto &c : levels_traversed) c.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    static inline void Bump(std::atomic<uint64_t> &c) {
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    inline ThreadSlot &Slot() {
+        uint32_t tid = FASTER::core::Thread::id();
+        assert(tid < slots_.size());
+        return slots_[tid];
+    }
+
+    static inline std::size_t Clamp(std::size_t level) {
+        return level < kMaxTrackedLevel ? level : kMaxTrackedLevel - 1;
+    }
+
+public:
+    static constexpr bool kEnabled = true;
+
+    // one slot per table thread, plus the same slack LockFreeHashTable gives data_pool_
+    explicit Counters(std::size_t thread_cnt) : slots_(thread_cnt + 2) {}
+
+    inline uint64_t StartOp() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    inline void EndOp(OpType op, uint64_t start) {
+        uint64_t ns = StartOp() - start;
+        std::size_t bucket = ns ? 63 - static_cast<std::size_t>(__builtin_clzll(ns)) : 0;
+        ThreadSlot &slot = Slot();
+        Bump(slot.latency[static_cast<std::size_t>(op)][bucket]);
+        Bump(slot.ops[static_cast<std::size_t>(op)]);
+    }
+
+    inline void CasFailure(std::size_t level) {
+        Bump(Slot().cas_failures[Clamp(level)]);
+    }
+
+    inline void LevelsTraversed(std::size_t levels) {
+        Bump(Slot().levels_traversed[levels < kMaxTrackedLevel ? levels : kMaxTrackedLevel]);
+    }
+
+    inline void FailLimitHit(OpType op) {
+        Bump(Slot().fail_limit_hits[static_cast<std::size_t>(op)]);
+    }
+
+    Snapshot Merge() const {
+        Snapshot ret;
+        for (const ThreadSlot &slot : slots_) {
+            for (std::size_t op = 0; op < kOpCount; op++) {
+                for (std::size_t b = 0; b < kLatencyBuckets; b++)
+                    ret.latency[op][b] += slot.latency[op][b].load(std::memory_order_relaxed);
+                ret.ops[op] += slot.ops[op].load(std::memory_order_relaxed);
+                ret.fail_limit_hits[op] += slot.fail_limit_hits[op].load(std::memory_order_relaxed);
+            }
+            for (std::size_t l = 0; l < kMaxTrackedLevel; l++)
+                ret.cas_failures[l] += slot.cas_failures[l].load(std::memory_order_relaxed);
+            for (std::size_t l = 0; l <= kMaxTrackedLevel; l++)
+                ret.levels_traversed[l] += slot.levels_traversed[l].load(std::memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    void Dump(std::ostream &os) const {
+        Merge().Dump(os);
+    }
+
+private:
+    std::vector<ThreadSlot> slots_;
+};
+
+} // namespace instrumentation
+} // namespace neatlib
+
+#endif //NEATLIB_INSTRUMENTATION_H
@@ -12,13 +12,17 @@
 #include <cassert>
 #include <memory>
 #include "util.h"
+#include "instrumentation.h"
+#include "trie_stats.h"
 #include "../util/NodeQueue.h"
 
 namespace neatlib {
 
 template<class Key, class T, class Hash = std::hash<Key>,
         std::size_t HASH_LEVEL = DEFAULT_NEATLIB_HASH_LEVEL,
-        std::size_t ROOT_HASH_LEVEL = DEFAULT_NEATLIB_HASH_LEVEL>
+        std::size_t ROOT_HASH_LEVEL = DEFAULT_NEATLIB_HASH_LEVEL,
+        class Instrumentation = instrumentation::None,
+        class Allocator = std::allocator<std::pair<const Key, T>>>
 class LockFreeHashTable {
 private:
     static constexpr size_t kArraySize =
@@ -31,6 +35,7 @@ private:
     using get_type = std::integral_constant<int, 1>;
     using update_type = std::integral_constant<int, 2>;
     using remove_type = std::integral_constant<int, 3>;
+    using op_type = instrumentation::OpType;
 
 private:
     enum class NodeType {
@@ -78,16 +83,58 @@ private:
         ~ArrayNode() override = default;
     };
 
-    static void RecursiveDestroyNode(Node *nodePtr) {
+    // Nodes come from Allocator rebound to each node type, which several
+    // threads call at once, so it has to be thread safe (std::allocator and
+    // HugePageAllocator are).
+    using DataNodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<DataNode>;
+    using ArrayNodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ArrayNode>;
+
+    // raw memory for a data node, shared with data_pool_
+    DataNode *AllocateDataNode() {
+        return std::allocator_traits<DataNodeAllocator>::allocate(data_alloc_, 1);
+    }
+
+    void DeallocateDataNode(DataNode *dataNodePtr) {
+        std::allocator_traits<DataNodeAllocator>::deallocate(data_alloc_, dataNodePtr, 1);
+    }
+
+    ArrayNode *NewArrayNode() {
+        return new(std::allocator_traits<ArrayNodeAllocator>::allocate(array_alloc_, 1)) ArrayNode;
+    }
+
+    void DeleteArrayNode(ArrayNode *arrNodePtr) {
+        arrNodePtr->~ArrayNode();
+        std::allocator_traits<ArrayNodeAllocator>::deallocate(array_alloc_, arrNodePtr, 1);
+    }
+
+    void RecursiveDestroyNode(Node *nodePtr) {
         if (nodePtr == nullptr) return;
-        else if (nodePtr->type == NodeType::Data) delete nodePtr;
+        else if (nodePtr->type == NodeType::Data) {
+            DataNode *dataNodePtr = static_cast<DataNode *>(nodePtr);
+            dataNodePtr->~DataNode();
+            DeallocateDataNode(dataNodePtr);
+        }
         else {
             assert(nodePtr->type == NodeType::Array);
             ArrayNode *arrNodePtr = static_cast<ArrayNode *>(nodePtr);
             for (std::atomic<Node *> &ptr : arrNodePtr->arr)
                 RecursiveDestroyNode(ptr.load(std::memory_order_relaxed));
-            delete arrNodePtr;
+            DeleteArrayNode(arrNodePtr);
+        }
+    }
+
+    static void CollectStats(const ArrayNode *arrNodePtr, size_t level, TrieStats &stats) {
+        size_t used = 0;
+        for (const std::atomic<Node *> &ptr : arrNodePtr->arr) {
+            Node *child = ptr.load();
+            if (child == nullptr) continue;
+            ++used;
+            if (child->type == NodeType::Data)
+                stats.RecordData(level);
+            else
+                CollectStats(static_cast<const ArrayNode *>(child), level + 1, stats);
         }
+        stats.RecordArray(level, used, kArraySize);
     }
 
     struct Locator {
@@ -99,12 +146,20 @@ private:
             assert(tid <= ht.data_pool_.size());
             DataNodeQueue &queue = ht.data_pool_[tid];
             if (!queue.Empty()) {
-                DataNode *ptr = queue.Pop();
-                ptr->type = NodeType::Data;
-                ptr->data.init(key, mapped);
-                return ptr;
+                // pooled nodes are raw memory, construct in place to get a valid vtable
+                return new(queue.Pop()) DataNode(key, mapped);
             }
-            return new DataNode(key, mapped);
+            return new(ht.AllocateDataNode()) DataNode(key, mapped);
+        }
+
+        // The thread's spare array if it has one, a new one otherwise.
+        inline static ArrayNode *NewArrayNode(LockFreeHashTable &ht) {
+            uint32_t tid = FASTER::core::Thread::id();
+            assert(tid < ht.spare_arrays_.size());
+            ArrayNode *spare = ht.spare_arrays_[tid];
+            if (spare == nullptr) return ht.NewArrayNode();
+            ht.spare_arrays_[tid] = nullptr;
+            return spare;
         }
 
 
@@ -120,6 +175,26 @@ private:
             explicit DataNodeDeleter(LockFreeHashTable *h) : ht(h) {}
         };
 
+        // An array that lost the expansion CAS was never published, so no
+        // other thread can reach it and it is kept, cleared, as the
+        // thread's spare for the next expansion. Freeing it would leak it
+        // with an allocator whose deallocate() does nothing, like
+        // HugePageAllocator.
+        struct ArrayNodeDeleter {
+            LockFreeHashTable *ht = nullptr;
+
+            inline void operator()(ArrayNode *node) const {
+                for (std::atomic<Node *> &ptr : node->arr)
+                    ptr.store(nullptr, std::memory_order_relaxed);
+                uint32_t tid = FASTER::core::Thread::id();
+                assert(tid < ht->spare_arrays_.size());
+                if (ht->spare_arrays_[tid] != nullptr) ht->DeleteArrayNode(ht->spare_arrays_[tid]);
+                ht->spare_arrays_[tid] = node;
+            }
+
+            explicit ArrayNodeDeleter(LockFreeHashTable *h) : ht(h) {}
+        };
+
 
         static inline size_t root_hash(std::size_t hash) {
             // get the hash fragment to address the root_
@@ -134,7 +209,7 @@ private:
         }
 
         using DataNodePtr = std::unique_ptr<Node, DataNodeDeleter>;
-        using ArrayNodePtr = std::unique_ptr<ArrayNode>;
+        using ArrayNodePtr = std::unique_ptr<ArrayNode, ArrayNodeDeleter>;
 
         void InsertOrUpdate(LockFreeHashTable &ht, const Key &key,
                             const T *mapped_ptr, size_t hash, bool insert) {
@@ -161,6 +236,7 @@ private:
                 for (; fail < kFailLimit; fail++) {
                     if (pos == nullptr) {
                         if (!insert) {
+                            ht.stats_.LevelsTraversed(level + 1);
                             return;
                         }
                         DataNodePtr tmp_ptr(NewDataNode(ht, key, *mapped_ptr), DataNodeDeleter(&ht));
@@ -169,6 +245,7 @@ private:
                             end = true;
                             break;
                         } else {
+                            ht.stats_.CasFailure(level);
                             continue;
                         }
                     } else if (pos->type == NodeType::Data) {
@@ -180,8 +257,10 @@ private:
                                 pos = old;
                                 tmp_ptr.release();
                                 assert(pos->type == NodeType::Data);
+                                ht.stats_.LevelsTraversed(level + 1);
                                 return;
                             } else {
+                                ht.stats_.CasFailure(level);
                                 continue;
                             }
                         } else { // for insert
@@ -190,7 +269,7 @@ private:
                                 end = true;
                                 break;
                             }
-                            ArrayNodePtr tmp_arr_ptr(new ArrayNode);
+                            ArrayNodePtr tmp_arr_ptr(NewArrayNode(ht), ArrayNodeDeleter(&ht));
                             size_t next_level_hash = level_hash(
                                     static_cast<DataNode *>(pos)->data.hash,
                                     level + 1
@@ -200,6 +279,7 @@ private:
                                 curr_arr_ptr = tmp_arr_ptr.release();
                                 break;
                             } else {
+                                ht.stats_.CasFailure(level);
                                 continue;
                             }
                         }
@@ -211,10 +291,14 @@ private:
 
                 }
                 if (fail == kFailLimit) {
+                    ht.stats_.FailLimitHit(insert ? op_type::Insert :
+                                           mapped_ptr != nullptr ? op_type::Update : op_type::Remove);
+                    ht.stats_.LevelsTraversed(level + 1);
                     pos = nullptr;
                     return;
                 }
             }
+            ht.stats_.LevelsTraversed(level);
             assert(insert);
         }
 
@@ -251,6 +335,7 @@ private:
                     curr_arr_ptr = static_cast<ArrayNode *>(pos);
                 }
             }
+            ht.stats_.LevelsTraversed(level + 1);
         }
 
         Locator(LockFreeHashTable &ht, const Key &key, const T &mapped, size_t hash, update_type) {
@@ -278,9 +363,14 @@ private:
 
 
 public:
-    explicit LockFreeHashTable(size_t expectedThreadCount, size_t expectedDataNum = 1000000) :
+    explicit LockFreeHashTable(size_t expectedThreadCount, size_t expectedDataNum = 1000000,
+                               const Allocator &alloc = Allocator()) :
+            data_alloc_(alloc),
+            array_alloc_(alloc),
             epoch_(expectedThreadCount),
-            data_pool_(expectedThreadCount + 2) {
+            data_pool_(expectedThreadCount + 2),
+            spare_arrays_(expectedThreadCount + 2, nullptr),
+            stats_(expectedThreadCount) {
         for (std::atomic<Node *> &ptr : root_)
             ptr.store(nullptr);
         size_t m = 1, num = kArraySize, level = 1;
@@ -298,7 +388,7 @@ public:
         size_t each = expectedDataNum / expectedThreadCount;
         for (uint32_t i = 0; i < expectedThreadCount; i++) {
             for (size_t j = 0; j < each; j++) {
-                data_pool_[i].Push((DataNode *) malloc(sizeof(DataNode)));
+                data_pool_[i].Push(AllocateDataNode());
             }
         }
     }
@@ -307,55 +397,130 @@ public:
         epoch_.EnterEpoch();
         for (std::atomic<Node *> &ptr : root_)
             RecursiveDestroyNode(ptr.load(std::memory_order_relaxed));
+        // the queues would free() what is left in them
+        for (DataNodeQueue &queue : data_pool_)
+            while (!queue.Empty()) DeallocateDataNode(queue.Pop());
+        for (ArrayNode *spare : spare_arrays_)
+            if (spare != nullptr) DeleteArrayNode(spare);
     }
 
     inline bool Insert(const Key &key, const T &mapped) {
+        uint64_t start = stats_.StartOp();
+        epoch_.EnterEpoch();
         Locator locator(*this, key, mapped, Hash()(key), insert_type());
-        DataNode *tmp = static_cast<DataNode *>(locator.pos);
-//        assert(locator.pos == nullptr || key == locator.GetKey() && mapped == locator.GetMapped());
+        epoch_.LeaveEpoch();
+        stats_.EndOp(op_type::Insert, start);
         return locator.pos != nullptr;
     }
 
     inline std::pair<const Key, T> Get(const Key &key) {
+        uint64_t start = stats_.StartOp();
         epoch_.EnterEpoch();
         Locator locator(*this, key, Hash()(key), get_type());
         if (locator.pos == nullptr) {
-            epoch_.EnterEpoch();
+            epoch_.LeaveEpoch();
+            stats_.EndOp(op_type::Get, start);
             throw std::out_of_range("No element found");
         }
         DataNode *dataNode = static_cast<DataNode *>(locator.pos);
         std::pair<const Key, T> ret{dataNode->data.key, dataNode->data.mapped};
         epoch_.LeaveEpoch();
+        stats_.EndOp(op_type::Get, start);
         return ret;
     }
 
     inline bool Update(const Key &key, const T &newMapped) {
+        uint64_t start = stats_.StartOp();
+        epoch_.EnterEpoch();
         Locator locator(*this, key, newMapped, Hash()(key), update_type());
         assert(locator.pos == nullptr || locator.pos->type == NodeType::Data);
+        // the old node is unlinked already, leave before retiring it so that
+        // a full drain list can never wait on this thread's own epoch
+        epoch_.LeaveEpoch();
         if (locator.pos == nullptr) {
-            epoch_.EnterEpoch();
+            stats_.EndOp(op_type::Update, start);
             return false;
         }
         epoch_.BumpEpoch(static_cast<Node *>(locator.pos), data_pool_);
+        stats_.EndOp(op_type::Update, start);
         return true;
     }
 
     inline bool Remove(const Key &key) {
+        uint64_t start = stats_.StartOp();
+        epoch_.EnterEpoch();
         Locator locator(*this, key, Hash()(key), remove_type());
+        epoch_.LeaveEpoch();
         if (locator.pos == nullptr) {
-            epoch_.EnterEpoch();
+            stats_.EndOp(op_type::Remove, start);
             return false;
         }
         assert(locator.GetKey() == key);
         epoch_.BumpEpoch(locator.pos, data_pool_);
+        stats_.EndOp(op_type::Remove, start);
         return true;
     }
 
+    // Walks the trie inside the epoch, so it is safe next to writers but
+    // only a snapshot. Epoch garbage counts retired DataNodes together with
+    // their delete contexts.
+    TrieStats Stats() {
+        using DeleteContext = epoch::Delete_Context<Node, std::vector<DataNodeQueue>>;
+        TrieStats stats;
+        size_t used = 0;
+        epoch_.EnterEpoch();
+        for (const std::atomic<Node *> &ptr : root_) {
+            Node *child = ptr.load();
+            if (child == nullptr) continue;
+            ++used;
+            if (child->type == NodeType::Data)
+                stats.RecordData(0);
+            else
+                CollectStats(static_cast<const ArrayNode *>(child), 1, stats);
+        }
+        epoch_.LeaveEpoch();
+        stats.RecordArray(0, used, kRootArraySize);
+        stats.node_bytes = sizeof(root_) +
+                           (stats.array_node_count - 1) * sizeof(ArrayNode) +
+                           stats.data_node_count * sizeof(DataNode);
+        for (const DataNodeQueue &queue : data_pool_)
+            stats.pool_bytes += queue.Size() * sizeof(DataNode);
+        stats.epoch_garbage_bytes = epoch_.PendingReclaimCount() * (sizeof(DataNode) + sizeof(DeleteContext));
+        return stats;
+    }
+
+    // Protects the calling thread the way every operation does, but until the
+    // matching LeaveEpoch(). Nothing retired meanwhile can be reclaimed, so a
+    // long protected section stalls reclamation for all threads. Calls nest.
+    void EnterEpoch() {
+        epoch_.EnterEpoch();
+    }
+
+    void LeaveEpoch() {
+        epoch_.LeaveEpoch();
+    }
+
+    // Counters of the epoch that reclaims this table's DataNodes.
+    FASTER::core::EpochTelemetry GetEpochTelemetry() const {
+        return epoch_.Telemetry();
+    }
+
+    // The instrumentation policy; Merge() and Dump() may be called while
+    // other threads keep operating on the table.
+    const Instrumentation &GetInstrumentation() const {
+        return stats_;
+    }
+
 private:
     using DataNodeQueue = NodeQueue<DataNode>;
+    DataNodeAllocator data_alloc_;
+    ArrayNodeAllocator array_alloc_;
     std::vector<DataNodeQueue> data_pool_;
+    // per thread, an array that lost an expansion CAS, see ArrayNodeDeleter
+    std::vector<ArrayNode *> spare_arrays_;
     epoch::MemoryEpoch<Node, std::vector<DataNodeQueue>, DataNode> epoch_;
     std::array<std::atomic<Node *>, kRootArraySize> root_;
+    Instrumentation stats_;
     size_t maxLevel_;
     size_t maxElement_;
 };
@@ -0,0 +1,170 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_SLAB_POOL_H
+#define NEATLIB_SLAB_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace neatlib {
+
+// Fixed size storage for objects of type T, carved from chunks that come
+// from Allocator (rebound to T's storage). Freed objects go on an intrusive
+// free list and are handed out again before a new chunk is taken. Chunks are
+// only returned all at once by Release() or the destructor, so the caller
+// must have destroyed every live object (or T must be trivially
+// destructible) by then. Not thread safe.
+template<typename T, typename Allocator = std::allocator<T>>
+class SlabPool {
+private:
+    union slot {
+        slot *next_free_;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+    };
+
+    // the chunk list lives in the first slot of every chunk
+    struct chunk_header {
+        slot *next_chunk_;
+        std::size_t slots_;
+    };
+
+    using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+
+    constexpr static std::size_t CHUNK_BYTES = 64 * 1024;
+
+    // chunks start small, so tiny tables stay tiny, and double up to about CHUNK_BYTES
+    std::size_t next_chunk_slots() const {
+        std::size_t max_slots = CHUNK_BYTES / sizeof(slot);
+        if (max_slots < 2) max_slots = 2;
+        std::size_t slots = chunk_count_ == 0 ? 16 : last_chunk_slots_ * 2;
+        return slots < max_slots ? slots : max_slots;
+    }
+
+    static std::size_t header_slots() {
+        return (sizeof(chunk_header) + sizeof(slot) - 1) / sizeof(slot);
+    }
+
+    void add_chunk(std::size_t object_slots) {
+        std::size_t total = object_slots + header_slots();
+        slot *chunk = std::allocator_traits<slot_allocator>::allocate(alloc_, total);
+        auto header = reinterpret_cast<chunk_header *>(chunk);
+        header->next_chunk_ = chunks_;
+        header->slots_ = total;
+        chunks_ = chunk;
+        for (std::size_t i = total; i > header_slots(); i--) {
+            chunk[i - 1].next_free_ = free_;
+            free_ = &chunk[i - 1];
+        }
+        free_count_ += object_slots;
+        ++chunk_count_;
+        chunk_bytes_ += total * sizeof(slot);
+        last_chunk_slots_ = object_slots;
+    }
+
+public:
+    explicit SlabPool(const Allocator &alloc = Allocator()) : alloc_(alloc) {}
+
+    SlabPool(const SlabPool &) = delete;
+
+    SlabPool &operator=(const SlabPool &) = delete;
+
+    ~SlabPool() {
+        Release();
+    }
+
+    // Uninitialized storage for one T.
+    T *Allocate() {
+        if (free_ == nullptr) add_chunk(next_chunk_slots());
+        slot *ret = free_;
+        free_ = ret->next_free_;
+        --free_count_;
+        return reinterpret_cast<T *>(ret);
+    }
+
+    // Takes back storage from Allocate(); the object must already be destroyed.
+    void Deallocate(T *ptr) {
+        assert(ptr != nullptr);
+        slot *s = reinterpret_cast<slot *>(ptr);
+        s->next_free_ = free_;
+        free_ = s;
+        ++free_count_;
+    }
+
+    // Makes sure the next count Allocate() calls take no new chunk.
+    void Reserve(std::size_t count) {
+        if (free_count_ < count) add_chunk(count - free_count_);
+    }
+
+    // Takes over every chunk and free slot of other, which is left empty.
+    // Both pools must use equal allocators, as the chunks are given back
+    // through this one.
+    void Adopt(SlabPool &other) {
+        if (other.chunks_ == nullptr) return;
+        slot *last = other.chunks_;
+        while (reinterpret_cast<chunk_header *>(last)->next_chunk_ != nullptr)
+            last = reinterpret_cast<chunk_header *>(last)->next_chunk_;
+        reinterpret_cast<chunk_header *>(last)->next_chunk_ = chunks_;
+        chunks_ = other.chunks_;
+        if (other.free_ != nullptr) {
+            slot *tail = other.free_;
+            while (tail->next_free_ != nullptr) tail = tail->next_free_;
+            tail->next_free_ = free_;
+            free_ = other.free_;
+        }
+        free_count_ += other.free_count_;
+        chunk_count_ += other.chunk_count_;
+        chunk_bytes_ += other.chunk_bytes_;
+        if (other.last_chunk_slots_ > last_chunk_slots_) last_chunk_slots_ = other.last_chunk_slots_;
+        other.chunks_ = nullptr;
+        other.free_ = nullptr;
+        other.free_count_ = 0;
+        other.chunk_count_ = 0;
+        other.chunk_bytes_ = 0;
+        other.last_chunk_slots_ = 0;
+    }
+
+    // Returns every chunk to the allocator at once.
+    void Release() {
+        while (chunks_ != nullptr) {
+            slot *chunk = chunks_;
+            auto header = reinterpret_cast<chunk_header *>(chunk);
+            chunks_ = header->next_chunk_;
+            std::allocator_traits<slot_allocator>::deallocate(alloc_, chunk, header->slots_);
+        }
+        free_ = nullptr;
+        free_count_ = 0;
+        chunk_count_ = 0;
+        chunk_bytes_ = 0;
+        last_chunk_slots_ = 0;
+    }
+
+    // a copy of the allocator the pool was made with
+    Allocator GetAllocator() const { return Allocator(alloc_); }
+
+    std::size_t FreeCount() const { return free_count_; }
+
+    std::size_t ChunkCount() const { return chunk_count_; }
+
+    // everything taken from the allocator, live and free slots and headers
+    std::size_t ChunkBytes() const { return chunk_bytes_; }
+
+    constexpr static std::size_t SlotBytes() { return sizeof(slot); }
+
+private:
+    slot_allocator alloc_;
+    slot *chunks_ = nullptr;
+    slot *free_ = nullptr;
+    std::size_t free_count_ = 0;
+    std::size_t chunk_count_ = 0;
+    std::size_t chunk_bytes_ = 0;
+    std::size_t last_chunk_slots_ = 0;
+};
+
+} // namespace neatlib
+
+#endif //NEATLIB_SLAB_POOL_H
@@ -0,0 +1,252 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_TRIE_SNAPSHOT_H
+#define NEATLIB_TRIE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NEATLIB_SNAPSHOT_MMAP 1
+#endif
+
+namespace neatlib {
+
+// Building blocks of the on-disk trie snapshots. A snapshot file is a
+// SnapshotHeader followed by node records; records point at each other by
+// their offset from the start of the file, so the file can be mapped at any
+// address and read in place. The tables define what the records hold. The
+// byte order and type layout are those of the machine that wrote the file,
+// which the header only partly checks (the sizes), so snapshots are meant
+// to be read on the same platform. The hash function is checked through a
+// fingerprint, the hashes of a few fixed keys.
+struct SnapshotHeader {
+    constexpr static uint32_t kVersion = 3;
+
+    // the first 8 bytes of every snapshot
+    static const char *Magic() { return "NEATSNAP"; }
+
+    char magic_[8];
+    uint32_t version_;
+    uint32_t hash_level_;
+    uint64_t root_hash_level_;
+    uint64_t key_size_;
+    uint64_t mapped_size_;
+    uint64_t entry_size_;
+    uint64_t size_;
+    uint64_t max_level_;
+    uint64_t hash_fingerprint_;
+    // reference to the root record, see SnapshotRef
+    uint64_t root_;
+    uint64_t file_size_;
+};
+
+// A record reference: the record offset with the record kind in the low
+// bits, which are free since every record starts at a multiple of 8.
+struct SnapshotRef {
+    constexpr static uint64_t kEmpty = 0;
+    constexpr static uint64_t kEntry = 1;
+    constexpr static uint64_t kArray = 2;
+    constexpr static uint64_t kBucket = 3;
+    constexpr static uint64_t kTagMask = 7;
+
+    static uint64_t Make(uint64_t offset, uint64_t tag) { return offset | tag; }
+
+    static uint64_t Tag(uint64_t ref) { return ref & kTagMask; }
+
+    static uint64_t Offset(uint64_t ref) { return ref & ~kTagMask; }
+};
+
+// Appends records to a new snapshot file, each one starting at a multiple
+// of the given alignment (at least 8). The records go to path + ".tmp",
+// which Finish() renames over path once it is complete and on disk, so a
+// process that still maps the old file keeps reading the old file and a
+// crash never leaves a half written snapshot at path. Throws
+// std::runtime_error when the file can not be written.
+class SnapshotWriter {
+public:
+    SnapshotWriter(const std::string &path, std::size_t align) :
+            path_(path), tmp_path_(path + ".tmp"), align_(align < 8 ? 8 : align) {
+        file_ = std::fopen(tmp_path_.c_str(), "wb");
+        if (file_ == nullptr) fail("can not create", tmp_path_);
+        // room for the header, written last by Finish()
+        SnapshotHeader header{};
+        Append(&header, sizeof(header));
+    }
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    // an unfinished file is thrown away
+    ~SnapshotWriter() {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+            std::remove(tmp_path_.c_str());
+        }
+    }
+
+    // Writes a record and returns its offset.
+    uint64_t Append(const void *data, std::size_t bytes) {
+        static const char zeros[64] = {};
+        std::size_t pad = (align_ - pos_ % align_) % align_;
+        while (pad > 0) {
+            std::size_t n = pad < sizeof(zeros) ? pad : sizeof(zeros);
+            write(zeros, n);
+            pad -= n;
+        }
+        uint64_t ret = pos_;
+        write(data, bytes);
+        return ret;
+    }
+
+    // Fills in the magic, version and file size, writes the header, syncs
+    // and closes the file and renames it to path.
+    void Finish(SnapshotHeader header) {
+        std::memcpy(header.magic_, SnapshotHeader::Magic(), sizeof(header.magic_));
+        header.version_ = SnapshotHeader::kVersion;
+        header.file_size_ = pos_;
+        if (std::fseek(file_, 0, SEEK_SET) != 0 ||
+            std::fwrite(&header, sizeof(header), 1, file_) != 1)
+            fail("can not write the header of", tmp_path_);
+        if (std::fflush(file_) != 0) fail("can not write", tmp_path_);
+#ifdef NEATLIB_SNAPSHOT_MMAP
+        if (::fsync(::fileno(file_)) != 0) fail("can not sync", tmp_path_);
+#endif
+        FILE *file = file_;
+        file_ = nullptr;
+        if (std::fclose(file) != 0) {
+            std::remove(tmp_path_.c_str());
+            fail("can not close", tmp_path_);
+        }
+        if (std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+            std::remove(tmp_path_.c_str());
+            fail("can not rename to", path_);
+        }
+    }
+
+private:
+    void write(const void *data, std::size_t bytes) {
+        if (bytes > 0 && std::fwrite(data, bytes, 1, file_) != 1) fail("can not write", tmp_path_);
+        pos_ += bytes;
+    }
+
+    [[noreturn]] static void fail(const char *what, const std::string &path) {
+        throw std::runtime_error(std::string("snapshot: ") + what + " " + path);
+    }
+
+    std::string path_;
+    std::string tmp_path_;
+    std::size_t align_;
+    FILE *file_ = nullptr;
+    uint64_t pos_ = 0;
+};
+
+// A snapshot file mapped read only. Pages are read in on first touch and
+// shared with every other process mapping the same file.
+class MappedSnapshot {
+public:
+    MappedSnapshot() = default;
+
+    // Maps the file and checks its header against what the reader expects.
+    // Throws std::runtime_error when it can not.
+    MappedSnapshot(const std::string &path, const SnapshotHeader &expected) {
+#ifdef NEATLIB_SNAPSHOT_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) fail("can not open", path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+            ::close(fd);
+            fail("too short", path);
+        }
+        bytes_ = static_cast<std::size_t>(st.st_size);
+        void *addr = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) fail("can not map", path);
+        base_ = static_cast<const char *>(addr);
+        const SnapshotHeader &header = Header();
+        if (std::memcmp(header.magic_, SnapshotHeader::Magic(), sizeof(header.magic_)) != 0 ||
+            header.version_ != SnapshotHeader::kVersion) {
+            unmap();
+            fail("not a snapshot:", path);
+        }
+        if (header.hash_level_ != expected.hash_level_ || header.root_hash_level_ != expected.root_hash_level_ ||
+            header.key_size_ != expected.key_size_ ||
+            header.mapped_size_ != expected.mapped_size_ || header.entry_size_ != expected.entry_size_ ||
+            header.file_size_ != bytes_) {
+            unmap();
+            fail("written for another table type, or truncated:", path);
+        }
+        if (header.hash_fingerprint_ != expected.hash_fingerprint_) {
+            unmap();
+            fail("written with another hash function:", path);
+        }
+#else
+        (void) expected;
+        fail("mapping files is not supported here:", path);
+#endif
+    }
+
+    MappedSnapshot(MappedSnapshot &&other) noexcept :
+            base_(other.base_), bytes_(other.bytes_) {
+        other.base_ = nullptr;
+        other.bytes_ = 0;
+    }
+
+    MappedSnapshot &operator=(MappedSnapshot &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            std::swap(base_, other.base_);
+            std::swap(bytes_, other.bytes_);
+        }
+        return *this;
+    }
+
+    MappedSnapshot(const MappedSnapshot &) = delete;
+
+    MappedSnapshot &operator=(const MappedSnapshot &) = delete;
+
+    ~MappedSnapshot() {
+        unmap();
+    }
+
+    const SnapshotHeader &Header() const { return *reinterpret_cast<const SnapshotHeader *>(base_); }
+
+    template<typename Record>
+    const Record *At(uint64_t ref) const {
+        return reinterpret_cast<const Record *>(base_ + SnapshotRef::Offset(ref));
+    }
+
+    std::size_t Bytes() const { return bytes_; }
+
+private:
+    void unmap() {
+#ifdef NEATLIB_SNAPSHOT_MMAP
+        if (base_ != nullptr) ::munmap(const_cast<char *>(base_), bytes_);
+#endif
+        base_ = nullptr;
+        bytes_ = 0;
+    }
+
+    [[noreturn]] static void fail(const char *what, const std::string &path) {
+        throw std::runtime_error(std::string("snapshot: ") + what + " " + path);
+    }
+
+    const char *base_ = nullptr;
+    std::size_t bytes_ = 0;
+};
+
+} // namespace neatlib
+
+#endif //NEATLIB_TRIE_SNAPSHOT_H
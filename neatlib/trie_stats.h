@@ -0,0 +1,95 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+
+#ifndef NEATLIB_TRIE_STATS_H
+#define NEATLIB_TRIE_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace neatlib {
+
+// Shape and memory usage of an array-node trie, filled by the Stats() call
+// of every table. Levels count from 0 at the root array, like the level
+// variable of the locators.
+struct TrieStats {
+    static constexpr std::size_t kFillBuckets = 10;
+
+    // data nodes found at each level
+    std::vector<std::size_t> depth_histogram;
+    // array nodes at each level, the root array included
+    std::vector<std::size_t> array_level_histogram;
+    // array nodes by fraction of used slots: bucket i holds fills in
+    // (i/10, (i+1)/10], empty arrays land in bucket 0
+    std::array<std::size_t, kFillBuckets> fill_histogram{};
+    std::size_t array_node_count = 0;
+    std::size_t data_node_count = 0;
+    std::size_t used_slots = 0;
+    std::size_t total_slots = 0;
+    // live array and data nodes reachable from the root
+    std::size_t node_bytes = 0;
+    // preallocated nodes waiting in the table's pools
+    std::size_t pool_bytes = 0;
+    // retired nodes the epoch has not reclaimed yet
+    std::size_t epoch_garbage_bytes = 0;
+
+    void RecordArray(std::size_t level, std::size_t used, std::size_t capacity) {
+        if (array_level_histogram.size() <= level) array_level_histogram.resize(level + 1, 0);
+        ++array_level_histogram[level];
+        ++array_node_count;
+        used_slots += used;
+        total_slots += capacity;
+        std::size_t bucket = used == 0 ? 0 : (used * kFillBuckets - 1) / capacity;
+        ++fill_histogram[bucket < kFillBuckets ? bucket : kFillBuckets - 1];
+    }
+
+    void RecordData(std::size_t level) {
+        if (depth_histogram.size() <= level) depth_histogram.resize(level + 1, 0);
+        ++depth_histogram[level];
+        ++data_node_count;
+    }
+
+    double AverageDepth() const {
+        std::size_t sum = 0;
+        for (std::size_t l = 0; l < depth_histogram.size(); l++)
+            sum += l * depth_histogram[l];
+        return data_node_count ? static_cast<double>(sum) / data_node_count : 0.0;
+    }
+
+    double FillRatio() const {
+        return total_slots ? static_cast<double>(used_slots) / total_slots : 0.0;
+    }
+
+    std::size_t TotalBytes() const {
+        return node_bytes + pool_bytes + epoch_garbage_bytes;
+    }
+
+    void Dump(std::ostream &os) const {
+        os << "data nodes:   " << data_node_count << "  avg level " << std::fixed
+           << std::setprecision(2) << AverageDepth() << "\n";
+        os << "array nodes:  " << array_node_count << "  fill " << FillRatio() * 100 << "%\n";
+        os << "level         data        array\n";
+        std::size_t levels = std::max(depth_histogram.size(), array_level_histogram.size());
+        for (std::size_t l = 0; l < levels; l++) {
+            os << std::setw(5) << l
+               << std::setw(13) << (l < depth_histogram.size() ? depth_histogram[l] : 0)
+               << std::setw(13) << (l < array_level_histogram.size() ? array_level_histogram[l] : 0)
+               << "\n";
+        }
+        os << "fill ratio:  ";
+        for (std::size_t b = 0; b < kFillBuckets; b++)
+            os << " <=" << (b + 1) * 10 << "%:" << fill_histogram[b];
+        os << "\n";
+        os << "bytes:        nodes " << node_bytes << "  pools " << pool_bytes
+           << "  epoch garbage " << epoch_garbage_bytes << "\n";
+    }
+};
+
+} // namespace neatlib
+
+#endif //NEATLIB_TRIE_STATS_H
@@ -1,6 +1,12 @@
 #ifndef NEATLIB_UTIL_H
 #define NEATLIB_UTIL_H
 
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
 #ifdef MAKE_UNIQUE_NOT_SUPPORT
 
 namespace std {
@@ -36,6 +42,13 @@ namespace std {
 
 #endif // MAKE_UNIQUE_NOT_SUPPORT
 
+// Hint that addr will be read soon; a no-op where the builtin is missing.
+#if defined(__GNUC__) || defined(__clang__)
+#define NEATLIB_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define NEATLIB_PREFETCH(addr) ((void) (addr))
+#endif
+
 namespace neatlib {
 
 constexpr std::size_t DEFAULT_NEATLIB_HASH_LEVEL = 4;
@@ -61,6 +74,29 @@ inline std::size_t level_hash(const std::size_t hash, const std::size_t level,
     return ret;
 }
 
+// Whether KeyEqual can throw comparing a stored Key with a K. std::equal_to
+// is not marked noexcept, so for it the key's own operator== decides.
+template<typename KeyEqual, typename Key, typename K = Key>
+struct nothrow_key_equal : std::integral_constant<bool,
+        noexcept(std::declval<const KeyEqual &>()(std::declval<const Key &>(), std::declval<const K &>()))> {};
+
+template<typename Key>
+struct nothrow_key_equal<std::equal_to<Key>, Key, Key> : std::integral_constant<bool,
+        noexcept(std::declval<const Key &>() == std::declval<const Key &>())> {};
+
+// Whether F declares is_transparent, as std::less<> and std::equal_to<> do:
+// it takes any key-like type, not just the key type of the table.
+template<typename T>
+struct to_void {
+    using type = void;
+};
+
+template<typename F, typename = void>
+struct is_transparent : std::false_type {};
+
+template<typename F>
+struct is_transparent<F, typename to_void<typename F::is_transparent>::type> : std::true_type {};
+
 } // namespace util
 
 }
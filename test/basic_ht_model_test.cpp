@@ -0,0 +1,254 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Checks BasicHashTable against std::unordered_map: random inserts,
+// updates and removals of integer and std::string keys down to an empty
+// table, one array growing through the 4, 16, 48 and full layouts and
+// shrinking back, keys whose full hashes collide and heterogeneous
+// lookup. Prints every mismatch and exits 1 if there was any.
+//
+// usage: basic_ht_model_test [ops=200000]
+//
+
+#include "neatlib/basic_hash_table.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+size_t failures = 0;
+
+void fail(const string &what) {
+    cout << "MISMATCH: " << what << endl;
+    ++failures;
+}
+
+// the key itself, so the test decides which slot every key lands in
+struct IdentityHash {
+    size_t operator()(uint64_t key) const noexcept { return static_cast<size_t>(key); }
+};
+
+// one full hash for every key, so all of them end up in one bucket
+struct ConstantHash {
+    size_t operator()(uint64_t) const noexcept { return 42; }
+
+    size_t operator()(const string &) const noexcept { return 42; }
+};
+
+template<typename K, typename V>
+using Table = neatlib::BasicHashTable<K, V>;
+
+template<typename K, typename V, typename Hash, size_t HASH_LEVEL, size_t ROOT_HASH_LEVEL = HASH_LEVEL>
+using TableOf = neatlib::BasicHashTable<K, V, Hash, std::equal_to<K>, std::allocator<std::pair<const K, V>>,
+        HASH_LEVEL, ROOT_HASH_LEVEL>;
+
+// keys and values of record r, scrambled so they spread over the whole trie
+uint64_t make(uint64_t r, uint64_t *) { return r * 0x9E3779B97F4A7C15ULL; }
+
+string make(uint64_t r, string *) { return "record-" + to_string(r) + "-padded-past-sso"; }
+
+// Compares every entry both ways, by lookup, by FindBatch (with a missing
+// key after every present one) and by iteration.
+template<typename HT, typename Map>
+void check_same(const HT &ht, const Map &model, const string &what) {
+    using K = typename HT::key_type;
+    if (ht.Size() != model.size()) {
+        fail(what + ": Size() " + to_string(ht.Size()) + ", expected " + to_string(model.size()));
+        return;
+    }
+    vector<K> keys;
+    for (const auto &kv : model) {
+        const auto *v = ht.FindPtr(kv.first);
+        if (v == nullptr || !(*v == kv.second) || !ht.Contains(kv.first)) {
+            fail(what + ": FindPtr of a present key");
+            return;
+        }
+        keys.push_back(kv.first);
+        keys.push_back(make(model.size() + keys.size() + (uint64_t(1) << 40), static_cast<K *>(nullptr)));
+    }
+    vector<const typename HT::value_type *> out(keys.size());
+    size_t found = ht.FindBatch(keys.data(), keys.size(), out.data());
+    bool batch_ok = found == model.size();
+    for (size_t i = 0; batch_ok && i < keys.size(); i++) {
+        auto it = model.find(keys[i]);
+        batch_ok = it == model.end() ? out[i] == nullptr
+                                     : out[i] != nullptr && out[i]->first == it->first && out[i]->second == it->second;
+    }
+    if (!batch_ok) fail(what + ": FindBatch");
+    size_t visited = 0;
+    for (const auto &kv : ht) {
+        ++visited;
+        auto it = model.find(kv.first);
+        if (it == model.end() || !(it->second == kv.second)) {
+            fail(what + ": iteration visits an entry the map does not have");
+            return;
+        }
+    }
+    if (visited != model.size())
+        fail(what + ": iteration visits " + to_string(visited) + " entries, expected " + to_string(model.size()));
+}
+
+// Only the root may be left once the last key is gone.
+template<typename HT>
+void check_empty(const HT &ht, const string &what) {
+    neatlib::TrieStats stats = ht.Stats();
+    if (ht.Size() != 0 || ht.begin() != ht.end() || stats.array_node_count != 1 || stats.data_node_count != 0)
+        fail(what + ": not empty after removing every key");
+}
+
+// Random Insert, Update, Remove, Emplace, TryEmplace, InsertOrAssign and
+// lookups over keys 0 to range - 1, every return value checked against
+// the map, then every key removed again.
+template<typename HT>
+void random_ops(const string &name, size_t ops, size_t range, uint64_t seed) {
+    using K = typename HT::key_type;
+    using V = typename HT::mapped_type;
+    HT ht;
+    unordered_map<K, V, typename HT::hasher> model;
+    mt19937_64 en(seed);
+    for (size_t i = 0; i < ops && failures == 0; i++) {
+        K key = make(en() % range, static_cast<K *>(nullptr));
+        V value = make(en(), static_cast<V *>(nullptr));
+        auto it = model.find(key);
+        bool present = it != model.end();
+        bool ok = true;
+        switch (en() % 8) {
+            case 0:
+            case 1:
+                ok = ht.Insert(key, value) == !present;
+                model.emplace(key, value);
+                break;
+            case 2:
+                ok = ht.Update(key, value) == present;
+                if (present) it->second = value;
+                break;
+            case 3:
+            case 4:
+                ok = ht.Remove(key) == present;
+                model.erase(key);
+                break;
+            case 5: {
+                auto ret = ht.InsertOrAssign(key, value);
+                ok = ret.second == !present && ret.first->first == key && ret.first->second == value;
+                model[key] = value;
+                break;
+            }
+            case 6: {
+                auto ret = ht.TryEmplace(key, value);
+                ok = ret.second == !present && ret.first->first == key;
+                model.emplace(key, value);
+                break;
+            }
+            default: {
+                auto ret = ht.Emplace(key, value);
+                ok = ret.second == !present && ret.first->first == key;
+                model.emplace(key, value);
+                break;
+            }
+        }
+        if (!ok) fail(name + ": operation " + to_string(i) + " returned the wrong result");
+        if (i % 4096 == 0) check_same(ht, model, name + " after " + to_string(i) + " operations");
+    }
+    check_same(ht, model, name);
+    vector<K> left;
+    for (const auto &kv : model) left.push_back(kv.first);
+    shuffle(left.begin(), left.end(), en);
+    for (size_t i = 0; i < left.size(); i++) {
+        if (!ht.Remove(left[i])) fail(name + ": Remove of a present key");
+        model.erase(left[i]);
+        if (i % 1024 == 0) check_same(ht, model, name + " while emptying");
+    }
+    check_empty(ht, name);
+}
+
+// capacity of the one array below the root, 0 when there is none
+template<typename HT>
+size_t child_capacity(const HT &ht, size_t root_slots) {
+    neatlib::TrieStats stats = ht.Stats();
+    return stats.array_node_count == 2 ? stats.total_slots - root_slots : 0;
+}
+
+// The keys i << 8 all share root slot 0 and take child slot i one level
+// down, so the array there grows to 4, 16, 48 and 256 slots as they come
+// in and shrinks back the same way as they go.
+void layouts() {
+    using HT = TableOf<uint64_t, uint64_t, IdentityHash, 8>;
+    HT ht;
+    unordered_map<uint64_t, uint64_t> model;
+    vector<size_t> grown, shrunk;
+    for (uint64_t i = 0; i < 256; i++) {
+        ht.Insert(i << 8, i);
+        model.emplace(i << 8, i);
+        check_same(ht, model, "layouts, growing to " + to_string(i + 1));
+        size_t cap = child_capacity(ht, 256);
+        if (cap != 0 && (grown.empty() || grown.back() != cap)) grown.push_back(cap);
+    }
+    vector<uint64_t> order(256);
+    for (uint64_t i = 0; i < 256; i++) order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937_64(3));
+    for (uint64_t i : order) {
+        ht.Remove(i << 8);
+        model.erase(i << 8);
+        check_same(ht, model, "layouts, shrinking to " + to_string(model.size()));
+        size_t cap = child_capacity(ht, 256);
+        if (cap != 0 && (shrunk.empty() || shrunk.back() != cap)) shrunk.push_back(cap);
+    }
+    if (grown != vector<size_t>{4, 16, 48, 256}) fail("layouts: growing does not go 4, 16, 48, 256");
+    if (shrunk != vector<size_t>{256, 48, 16, 4}) fail("layouts: shrinking does not go 256, 48, 16, 4");
+    check_empty(ht, "layouts");
+}
+
+// Lookups by const char * and std::string_view of a table of std::string
+// keys under StringHash and std::equal_to<>.
+void transparent() {
+    neatlib::BasicHashTable<string, uint64_t, neatlib::StringHash, std::equal_to<>> ht;
+    vector<string> keys;
+    for (uint64_t i = 0; i < 2000; i++) keys.push_back(make(i, static_cast<string *>(nullptr)));
+    for (uint64_t i = 0; i < keys.size(); i += 2) ht.Insert(keys[i], i);
+    vector<const char *> c_keys;
+    for (const string &key : keys) c_keys.push_back(key.c_str());
+    for (uint64_t i = 0; i < keys.size(); i++) {
+        bool present = i % 2 == 0;
+        const uint64_t *v = ht.FindPtr(c_keys[i]);
+        if ((v != nullptr) != present || (present && *v != i) || ht.Contains(c_keys[i]) != present)
+            fail("transparent: const char * lookup of " + keys[i]);
+#ifdef NEATLIB_HAS_STRING_VIEW
+        std::string_view view(keys[i]);
+        v = ht.FindPtr(view);
+        if ((v != nullptr) != present || (present && *v != i) || ht.Contains(view) != present)
+            fail("transparent: std::string_view lookup of " + keys[i]);
+#endif
+    }
+    vector<const typename decltype(ht)::value_type *> out(c_keys.size());
+    if (ht.FindBatch(c_keys.data(), c_keys.size(), out.data()) != keys.size() / 2)
+        fail("transparent: FindBatch of const char * keys");
+    for (uint64_t i = 0; i < keys.size(); i += 2) {
+        if (!ht.Remove(c_keys[i])) fail("transparent: Remove by const char *");
+    }
+    check_empty(ht, "transparent");
+}
+
+int main(int argc, const char *argv[]) {
+    size_t ops = argc >= 2 ? stoull(string(argv[1])) : 200000;
+
+    layouts();
+    random_ops<Table<uint64_t, uint64_t>>("uint64 keys", ops, 20000, 1);
+    random_ops<TableOf<uint64_t, uint64_t, std::hash<uint64_t>, 4, 16>>("uint64 keys, root 16", ops, 20000, 2);
+    random_ops<TableOf<uint64_t, uint64_t, std::hash<uint64_t>, 8>>("uint64 keys, level 8", ops, 20000, 3);
+    random_ops<Table<string, string>>("string keys", ops / 4, 5000, 4);
+    random_ops<TableOf<uint64_t, uint64_t, ConstantHash, 4>>("colliding uint64 keys", ops / 20, 300, 5);
+    random_ops<TableOf<string, string, ConstantHash, 4>>("colliding string keys", ops / 20, 300, 6);
+    transparent();
+
+    if (failures != 0) {
+        cout << failures << " MISMATCHES" << endl;
+        return 1;
+    }
+    cout << "OK" << endl;
+    return 0;
+}
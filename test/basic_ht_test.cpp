@@ -1,20 +1,51 @@
 //
 // Created by jiahua on 2019/3/13.
 //
+// usage: basic_ht_test [elements] [range]
+//
 
 #include "neatlib/basic_hash_table.h"
 #include <chrono>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
 #include <vector>
 #include <iostream>
 
 using namespace std;
 using namespace chrono;
 
-constexpr size_t RANGE = 20000000;
-constexpr size_t TOTAL_ELEMENTS = 10000000;
+size_t RANGE = 20000000;
+size_t TOTAL_ELEMENTS = 10000000;
+
+// Iterates ht and counts what is wrong with the pass: entries visited
+// twice, entries Get does not find or finds with another value, entries
+// that do not hold value, and one more when the pass does not visit
+// exactly Size() entries.
+template<typename HT>
+size_t iteration_errors(HT &ht, size_t value) {
+    size_t visited = 0, bad = 0;
+    unordered_set<size_t> seen;
+    for (const auto &kv : ht) {
+        ++visited;
+        if (!seen.insert(kv.first).second || kv.second != value) {
+            ++bad;
+            continue;
+        }
+        try {
+            if (ht.Get(kv.first).second != value) ++bad;
+        } catch (const out_of_range &) {
+            ++bad;
+        }
+    }
+    if (visited != ht.Size()) ++bad;
+    return bad;
+}
 
-int main() {
+int main(int argc, const char *argv[]) {
+    if (argc >= 2) TOTAL_ELEMENTS = stoull(string(argv[1]));
+    if (argc >= 3) RANGE = stoull(string(argv[2]));
     vector<size_t> keys(TOTAL_ELEMENTS, 0);
     neatlib::BasicHashTable<size_t,
                               size_t,
@@ -24,9 +55,15 @@ int main() {
                               8> bht;
     default_random_engine en(static_cast<unsigned int>(steady_clock::now().time_since_epoch().count()));
     uniform_int_distribution<size_t> dis(0, RANGE);
-    std::size_t right = 0, right2 = 0, right3 = 0;
+    std::size_t right = 0, right2 = 0, right3 = 0, right4 = 0;
     for (auto &i : keys) i = dis(en);
 
+    size_t errors = 0;
+    if (bht.begin() != bht.end()) {
+        cout << "EMPTY TABLE ITERATES" << endl;
+        ++errors;
+    }
+
     auto t1 = steady_clock::now();
     for (const auto &i : keys)
         bht.Insert(i, 10);
@@ -43,17 +80,43 @@ int main() {
             ++right2;
     auto t4 = steady_clock::now();
 
-    for (const auto &i : keys)
-        if (bht.Remove(i))
+    for (const auto &kv : bht)
+        if (kv.second == 20)
+            ++right4;
+    auto t45 = steady_clock::now();
+    if (right4 != bht.Size() || iteration_errors(bht, 20) != 0) {
+        cout << "ITERATION MISMATCH" << endl;
+        ++errors;
+    }
+
+    // the first half goes first, so the second pass runs over arrays
+    // Remove has contracted or moved to smaller layouts
+    size_t half = keys.size() / 2;
+    auto t46 = steady_clock::now();
+    for (size_t i = 0; i < half; i++)
+        if (bht.Remove(keys[i]))
+            ++right3;
+    auto t47 = steady_clock::now();
+    if (iteration_errors(bht, 20) != 0) {
+        cout << "ITERATION MISMATCH AFTER REMOVE" << endl;
+        ++errors;
+    }
+    auto t48 = steady_clock::now();
+    for (size_t i = half; i < keys.size(); i++)
+        if (bht.Remove(keys[i]))
             ++right3;
 
     auto t5 = steady_clock::now();
+    if (bht.Size() != 0 || bht.begin() != bht.end()) {
+        cout << "EMPTIED TABLE ITERATES" << endl;
+        ++errors;
+    }
 
     cout << "INSERTION TIME: " << duration_cast<milliseconds>(t2 - t1).count() << endl;
     cout << "GETTING TIME:   " << duration_cast<milliseconds>(t3 - t2).count() << "  " << right << endl;
     cout << "UPDATING TIME:  " << duration_cast<milliseconds>(t4 - t3).count() << "  " << right2 << endl;
-    cout << "REMOVING TIME:  " << duration_cast<milliseconds>(t5 - t4).count() << "  " << bht.Size() << "  "
-         << right3 << endl;
-
+    cout << "ITERATING TIME: " << duration_cast<milliseconds>(t45 - t4).count() << "  " << right4 << endl;
+    cout << "REMOVING TIME:  " << duration_cast<milliseconds>(t47 - t46 + t5 - t48).count() << "  "
+         << bht.Size() << "  " << right3 << endl;
+    return errors == 0 ? 0 : 1;
 }
-
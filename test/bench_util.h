@@ -0,0 +1,489 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Shared pieces of the benchmark executables: a common adapter over the
+// hash tables, YCSB-style key generators, a latency histogram and a tiny
+// "key=value" option parser.
+//
+
+#ifndef NEATLIB_BENCH_UTIL_H
+#define NEATLIB_BENCH_UTIL_H
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "neatlib/basic_hash_table.h"
+#include "neatlib/concurrent_hash_table.h"
+#include "neatlib/flat_hash_table.h"
+#include "neatlib/lock_free_hash_table.h"
+
+#ifdef __linux__
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+using clock_type = std::chrono::steady_clock;
+
+inline uint64_t NowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now().time_since_epoch()).count());
+}
+
+// Resident set size of the process in bytes, 0 where it cannot be read.
+inline std::size_t ResidentBytes() {
+    std::size_t ret = 0;
+#ifdef __linux__
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long size = 0, resident = 0;
+        if (fscanf(statm, "%lu %lu", &size, &resident) == 2)
+            ret = resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        fclose(statm);
+    }
+#endif
+    return ret;
+}
+
+// FNV-1a over the 8 bytes of a 64 bit integer, the scrambler YCSB uses to
+// turn record numbers into keys.
+inline uint64_t Fnv64(uint64_t val) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < 8; i++) {
+        hash ^= val & 0xFF;
+        hash *= 1099511628211ULL;
+        val >>= 8;
+    }
+    return hash;
+}
+
+// A bijective scrambler, so n distinct record numbers give n distinct keys
+// spread over all 64 bits; cheaper than Fnv64 where the hash is not the point.
+inline uint64_t MakeKey(uint64_t i) {
+    uint64_t x = i * 0x9E3779B97F4A7C15ULL;
+    return x ^ (x >> 32);
+}
+
+// A count with an optional K, M or G suffix (powers of 1000), so "10M" is
+// 10000000. Throws std::invalid_argument on anything else after the number.
+inline std::size_t ParseSize(const std::string &s) {
+    std::size_t end = 0;
+    unsigned long long ret = std::stoull(s, &end);
+    if (end < s.size()) {
+        char suffix = static_cast<char>(std::toupper(static_cast<unsigned char>(s[end])));
+        if (suffix == 'K') ret *= 1000ULL;
+        else if (suffix == 'M') ret *= 1000000ULL;
+        else if (suffix == 'G') ret *= 1000000000ULL;
+        else end = 0;
+        if (end == 0 || end + 1 != s.size()) throw std::invalid_argument("not a count: " + s);
+    }
+    return static_cast<std::size_t>(ret);
+}
+
+// after - before of a gauge that can also shrink, such as the RSS
+inline int64_t SignedDelta(std::size_t after, std::size_t before) {
+    return static_cast<int64_t>(after) - static_cast<int64_t>(before);
+}
+
+// "key=value" command line arguments with defaults.
+class Options {
+public:
+    Options(int argc, const char *argv[]) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg(argv[i]);
+            auto eq = arg.find('=');
+            if (eq == std::string::npos)
+                values_[arg] = "1";
+            else
+                values_[arg.substr(0, eq)] = arg.substr(eq + 1);
+        }
+    }
+
+    std::string Get(const std::string &name, const std::string &def) const {
+        auto it = values_.find(name);
+        return it == values_.end() ? def : it->second;
+    }
+
+    std::size_t GetSize(const std::string &name, std::size_t def) const {
+        auto it = values_.find(name);
+        return it == values_.end() ? def : ParseSize(it->second);
+    }
+
+    double GetDouble(const std::string &name, double def) const {
+        auto it = values_.find(name);
+        return it == values_.end() ? def : std::stod(it->second);
+    }
+
+private:
+    std::map<std::string, std::string> values_;
+};
+
+// Log-linear latency histogram: 16 sub-buckets per power of two, so every
+// reported percentile is within ~6% of the recorded value.
+class LatencyHistogram {
+private:
+    static constexpr std::size_t kSubBits = 4;
+    static constexpr std::size_t kSubBuckets = 1u << kSubBits;
+    static constexpr std::size_t kBuckets = 64 * kSubBuckets;
+
+    static std::size_t BucketOf(uint64_t ns) {
+        if (ns < kSubBuckets) return static_cast<std::size_t>(ns);
+        std::size_t msb = 63 - static_cast<std::size_t>(__builtin_clzll(ns));
+        std::size_t sub = static_cast<std::size_t>(ns >> (msb - kSubBits)) & (kSubBuckets - 1);
+        return (msb - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    static uint64_t ValueOf(std::size_t bucket) {
+        if (bucket < kSubBuckets) return bucket;
+        std::size_t msb = bucket / kSubBuckets + kSubBits - 1;
+        uint64_t sub = bucket % kSubBuckets;
+        return ((kSubBuckets | sub) << (msb - kSubBits));
+    }
+
+public:
+    LatencyHistogram() : counts_(kBuckets, 0) {}
+
+    void Record(uint64_t ns) {
+        ++counts_[BucketOf(ns)];
+        ++total_;
+        sum_ += ns;
+        if (ns > max_) max_ = ns;
+    }
+
+    void Merge(const LatencyHistogram &other) {
+        for (std::size_t i = 0; i < kBuckets; i++)
+            counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        sum_ += other.sum_;
+        if (other.max_ > max_) max_ = other.max_;
+    }
+
+    uint64_t Percentile(double p) const {
+        if (total_ == 0) return 0;
+        auto rank = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(total_)));
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; i++) {
+            seen += counts_[i];
+            if (seen >= rank) return ValueOf(i);
+        }
+        return max_;
+    }
+
+    uint64_t Count() const { return total_; }
+
+    uint64_t Max() const { return max_; }
+
+    double Mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0.0; }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+// Zipfian generator over [0, n), after Gray et al. "Quickly Generating
+// Billion-Record Synthetic Databases" as used by YCSB.
+class ZipfianGenerator {
+public:
+    explicit ZipfianGenerator(uint64_t n, double theta = 0.99) :
+            n_(n), theta_(theta) {
+        zeta2_ = Zeta(2, theta_);
+        zetan_ = Zeta(n_, theta_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1 - std::pow(2.0 / n_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+    }
+
+    template<typename Engine>
+    uint64_t Next(Engine &en) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(en);
+        double uz = u * zetan_;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+        auto ret = static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+        return ret < n_ ? ret : n_ - 1;
+    }
+
+private:
+    static double Zeta(uint64_t n, double theta) {
+        double sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            sum += 1 / std::pow(i + 1, theta);
+        return sum;
+    }
+
+    uint64_t n_;
+    double theta_;
+    double zeta2_ = 0, zetan_ = 0, alpha_ = 0, eta_ = 0;
+};
+
+enum class Distribution {
+    Uniform, Zipfian, Latest, Sequential
+};
+
+inline Distribution ParseDistribution(const std::string &name) {
+    if (name == "uniform") return Distribution::Uniform;
+    if (name == "zipfian") return Distribution::Zipfian;
+    if (name == "latest") return Distribution::Latest;
+    if (name == "sequential") return Distribution::Sequential;
+    throw std::invalid_argument("unknown distribution: " + name);
+}
+
+// Picks record numbers for one thread. The record count grows while the
+// benchmark inserts, "latest" follows the newest records.
+class KeyChooser {
+public:
+    KeyChooser(Distribution dist, const ZipfianGenerator &zipf,
+               const std::atomic<uint64_t> &record_count, uint64_t seed) :
+            dist_(dist), zipf_(zipf), record_count_(record_count),
+            en_(static_cast<std::default_random_engine::result_type>(seed)), seq_(seed * 7919) {}
+
+    uint64_t Next() {
+        uint64_t n = record_count_.load(std::memory_order_relaxed);
+        switch (dist_) {
+            case Distribution::Uniform:
+                return std::uniform_int_distribution<uint64_t>(0, n - 1)(en_);
+            case Distribution::Zipfian:
+                // scrambled so the hot records are not clustered at the start of the key space
+                return Fnv64(zipf_.Next(en_)) % n;
+            case Distribution::Latest: {
+                uint64_t back = zipf_.Next(en_);
+                return back < n ? n - 1 - back : 0;
+            }
+            case Distribution::Sequential:
+            default:
+                return seq_++ % n;
+        }
+    }
+
+    std::default_random_engine &Engine() { return en_; }
+
+private:
+    Distribution dist_;
+    ZipfianGenerator zipf_;
+    const std::atomic<uint64_t> &record_count_;
+    std::default_random_engine en_;
+    uint64_t seq_;
+};
+
+enum OpType {
+    kRead = 0, kUpdate, kInsert, kRemove, kScan, kReadModifyWrite, kOpTypeCount
+};
+
+inline const char *OpName(std::size_t op) {
+    static const char *names[kOpTypeCount] = {"READ", "UPDATE", "INSERT", "REMOVE", "SCAN", "RMW"};
+    return names[op];
+}
+
+// Operation proportions of a workload, in percent.
+struct Workload {
+    std::string name;
+    double proportion[kOpTypeCount] = {0, 0, 0, 0, 0, 0};
+    Distribution dist = Distribution::Zipfian;
+    std::size_t scan_length = 16;
+
+    OpType Pick(double r) const {
+        double acc = 0;
+        for (std::size_t i = 0; i < kOpTypeCount; i++) {
+            acc += proportion[i];
+            if (r * 100.0 < acc) return static_cast<OpType>(i);
+        }
+        return kRead;
+    }
+};
+
+// The core YCSB workloads. Hash tables cannot scan, so E reads scan_length
+// consecutive records with point lookups instead.
+inline Workload MakeWorkload(const std::string &name) {
+    Workload w;
+    w.name = name;
+    if (name == "A") {
+        w.proportion[kRead] = 50, w.proportion[kUpdate] = 50;
+    } else if (name == "B") {
+        w.proportion[kRead] = 95, w.proportion[kUpdate] = 5;
+    } else if (name == "C") {
+        w.proportion[kRead] = 100;
+    } else if (name == "D") {
+        w.proportion[kRead] = 95, w.proportion[kInsert] = 5;
+        w.dist = Distribution::Latest;
+    } else if (name == "E") {
+        w.proportion[kScan] = 95, w.proportion[kInsert] = 5;
+    } else if (name == "F") {
+        w.proportion[kRead] = 50, w.proportion[kReadModifyWrite] = 50;
+    } else {
+        throw std::invalid_argument("unknown workload: " + name);
+    }
+    return w;
+}
+
+inline void PrintEpochTelemetry(std::ostream &os, const FASTER::core::EpochTelemetry &t) {
+    uint64_t drains = 0;
+    for (uint64_t d : t.drain_calls_per_thread) drains += d;
+    os << "epoch: current=" << t.current_epoch << " lag=" << t.reclaim_lag
+       << " max_lag=" << t.max_reclaim_lag
+       << " pending=" << t.pending_drain_actions << "/" << t.drain_list_capacity
+       << " retired=" << t.retired << " reclaimed=" << t.reclaimed
+       << " reclaim_latency(mean/max)=" << static_cast<uint64_t>(t.MeanReclaimLatencyNs())
+       << "ns/" << t.reclaim_latency_max_ns << "ns"
+       << " drain_calls=" << drains << " slowdowns=" << t.slowdown_events << "\n";
+}
+
+// Common adapter interface: every adapter is constructed with the expected
+// thread and record counts and exposes boolean Insert/Read/Update/Remove.
+template<typename HT>
+class TableAdapterBase {
+public:
+    template<typename... Args>
+    explicit TableAdapterBase(Args &&... args) : ht_(std::forward<Args>(args)...) {}
+
+    bool Insert(uint64_t key, uint64_t value) { return ht_.Insert(key, value); }
+
+    bool Read(uint64_t key, uint64_t &value) {
+        try {
+            value = ht_.Get(key).second;
+            return true;
+        } catch (const std::out_of_range &) {
+            return false;
+        }
+    }
+
+    bool Update(uint64_t key, uint64_t value) { return ht_.Update(key, value); }
+
+    bool Remove(uint64_t key) { return ht_.Remove(key); }
+
+    // prints whatever internal counters the table keeps
+    void Report(std::ostream &) {}
+
+    neatlib::TrieStats Stats() { return ht_.Stats(); }
+
+    HT &Table() { return ht_; }
+
+protected:
+    HT ht_;
+};
+
+template<typename HT>
+class BasicTableAdapter : public TableAdapterBase<HT> {
+public:
+    static constexpr bool kConcurrent = false;
+
+    BasicTableAdapter(std::size_t, std::size_t records) : TableAdapterBase<HT>(records) {}
+
+    // misses neither allocate nor throw
+    bool Read(uint64_t key, uint64_t &value) {
+        const uint64_t *mapped = this->ht_.FindPtr(key);
+        if (mapped == nullptr) return false;
+        value = *mapped;
+        return true;
+    }
+};
+
+template<typename HT>
+class ConcurrentTableAdapter : public TableAdapterBase<HT> {
+public:
+    static constexpr bool kConcurrent = true;
+
+    ConcurrentTableAdapter(std::size_t, std::size_t records) : TableAdapterBase<HT>(records) {}
+};
+
+template<typename HT>
+class LockFreeTableAdapter : public TableAdapterBase<HT> {
+public:
+    static constexpr bool kConcurrent = true;
+
+    // worker threads get FASTER thread ids starting at 1, the main thread holds 0
+    LockFreeTableAdapter(std::size_t threads, std::size_t records) :
+            TableAdapterBase<HT>(threads + 1, records) {}
+
+    void Report(std::ostream &os) {
+        this->ht_.GetInstrumentation().Dump(os);
+        PrintEpochTelemetry(os, this->ht_.GetEpochTelemetry());
+    }
+};
+
+using BasicHT4 = neatlib::BasicHashTable<uint64_t, uint64_t, std::hash<uint64_t>,
+        std::equal_to<uint64_t>, std::allocator<std::pair<const uint64_t, uint64_t>>, 4>;
+using BasicHT8 = neatlib::BasicHashTable<uint64_t, uint64_t, std::hash<uint64_t>,
+        std::equal_to<uint64_t>, std::allocator<std::pair<const uint64_t, uint64_t>>, 8>;
+using BasicHT416 = neatlib::BasicHashTable<uint64_t, uint64_t, std::hash<uint64_t>,
+        std::equal_to<uint64_t>, std::allocator<std::pair<const uint64_t, uint64_t>>, 4, 16>;
+
+using BasicTable4 = BasicTableAdapter<BasicHT4>;
+using BasicTable8 = BasicTableAdapter<BasicHT8>;
+using BasicTable416 = BasicTableAdapter<BasicHT416>;
+using FlatTable = BasicTableAdapter<neatlib::FlatHashTable<uint64_t, uint64_t>>;
+using ConcurrentTable48 = ConcurrentTableAdapter<neatlib::ConcurrentHashTable<uint64_t, uint64_t,
+        std::hash<uint64_t>, 4, 8>>;
+using LockFreeTable48 = LockFreeTableAdapter<neatlib::LockFreeHashTable<uint64_t, uint64_t,
+        std::hash<uint64_t>, 4, 8>>;
+using LockFreeTable416 = LockFreeTableAdapter<neatlib::LockFreeHashTable<uint64_t, uint64_t,
+        std::hash<uint64_t>, 4, 16>>;
+using LockFreeCountersTable48 = LockFreeTableAdapter<neatlib::LockFreeHashTable<uint64_t, uint64_t,
+        std::hash<uint64_t>, 4, 8, neatlib::instrumentation::Counters>>;
+
+// Calls f with a null Adapter * for the adapter registered under name, so a
+// generic lambda can recover the type. The names are
+// engine:HASH_LEVEL[:ROOT_HASH_LEVEL], or just the engine for the flat table.
+template<typename F>
+bool DispatchTable(const std::string &name, F &&f) {
+    if (name == "basic:4") f(static_cast<BasicTable4 *>(nullptr));
+    else if (name == "basic:8") f(static_cast<BasicTable8 *>(nullptr));
+    else if (name == "basic:4:16") f(static_cast<BasicTable416 *>(nullptr));
+    else if (name == "flat") f(static_cast<FlatTable *>(nullptr));
+    else if (name == "concurrent:4:8") f(static_cast<ConcurrentTable48 *>(nullptr));
+    else if (name == "lockfree:4:8") f(static_cast<LockFreeTable48 *>(nullptr));
+    else if (name == "lockfree:4:16") f(static_cast<LockFreeTable416 *>(nullptr));
+    else if (name == "lockfree-counters:4:8") f(static_cast<LockFreeCountersTable48 *>(nullptr));
+    else return false;
+    return true;
+}
+
+// DispatchTable over the bare BasicHashTable types rather than adapters, for
+// the benches of what only BasicHashTable has (BuildFrom, snapshots).
+template<typename F>
+bool DispatchBasicTable(const std::string &name, F &&f) {
+    if (name == "basic:4") f(static_cast<BasicHT4 *>(nullptr));
+    else if (name == "basic:8") f(static_cast<BasicHT8 *>(nullptr));
+    else if (name == "basic:4:16") f(static_cast<BasicHT416 *>(nullptr));
+    else return false;
+    return true;
+}
+
+inline std::vector<std::string> TableNames() {
+    return {"basic:4", "basic:8", "basic:4:16", "flat", "concurrent:4:8", "lockfree:4:8", "lockfree:4:16",
+            "lockfree-counters:4:8"};
+}
+
+// "a,b,c" option values
+inline std::vector<std::string> Split(const std::string &s, char sep = ',') {
+    std::vector<std::string> ret;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep))
+        if (!item.empty()) ret.push_back(item);
+    return ret;
+}
+
+inline std::string FormatNs(uint64_t ns) {
+    std::ostringstream os;
+    if (ns < 10000) os << ns << "ns";
+    else if (ns < 10000000) os << ns / 1000 << "us";
+    else os << ns / 1000000 << "ms";
+    return os.str();
+}
+
+} // namespace bench
+
+#endif //NEATLIB_BENCH_UTIL_H
@@ -0,0 +1,72 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Loading a BasicHashTable from n (key, value) pairs: a loop of Insert
+// against BuildFrom() on 1, 2, 4, ... threads, and a lookup pass over the
+// result of each to check it.
+//
+// usage: build_bench [table=basic:4|basic:8|basic:4:16] [n=10000000] [threads=1,2,4,8]
+//
+#include <random>
+#include <thread>
+#include "bench_util.h"
+
+using namespace std;
+using namespace bench;
+
+// entries whose value does not match, out of n
+template<typename HT>
+size_t wrong_values(const HT &ht, const vector<pair<uint64_t, uint64_t>> &input) {
+    size_t bad = 0;
+    for (auto &p : input) {
+        const uint64_t *v = ht.FindPtr(p.first);
+        bad += v == nullptr || *v != p.second;
+    }
+    return bad;
+}
+
+template<typename HT>
+void report(const char *what, const HT &ht, uint64_t ns, const vector<pair<uint64_t, uint64_t>> &input) {
+    size_t bad = wrong_values(ht, input);
+    cout << "  " << left << setw(24) << what << right << fixed << setprecision(3) << double(ns) / 1e9 << " s, "
+         << setprecision(1) << double(ns) / input.size() << " ns/entry, "
+         << ht.Stats().node_bytes / (1024 * 1024) << " MB of nodes"
+         << (bad ? ", " + to_string(bad) + " wrong values" : "") << endl;
+}
+
+template<typename HT>
+void run(const string &name, const Options &opt) {
+    size_t n = max<size_t>(1, opt.GetSize("n", 10000000));
+    vector<pair<uint64_t, uint64_t>> input(n);
+    for (size_t i = 0; i < n; i++) input[i] = {MakeKey(i), i};
+    shuffle(input.begin(), input.end(), mt19937_64(42));
+
+    cout << "TABLE: " << name << "  N: " << n << "  CORES: " << thread::hardware_concurrency() << endl;
+    {
+        uint64_t start = NowNs();
+        HT ht(n);
+        for (auto &p : input) ht.Insert(p.first, p.second);
+        report("INSERT LOOP:", ht, NowNs() - start, input);
+    }
+    for (const string &t : Split(opt.Get("threads", "1,2,4,8"))) {
+        size_t threads = stoul(t);
+        uint64_t start = NowNs();
+        HT ht;
+        ht.BuildFrom(input, threads);
+        string what = "BUILD_FROM " + t + " THREADS:";
+        report(what.c_str(), ht, NowNs() - start, input);
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    string table = opt.Get("table", "basic:8");
+    bool found = DispatchBasicTable(table, [&](auto *tag) {
+        run<typename remove_pointer<decltype(tag)>::type>(table, opt);
+    });
+    if (!found) {
+        cerr << "unknown table: " << table << endl;
+        return 1;
+    }
+    return 0;
+}
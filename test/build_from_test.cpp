@@ -0,0 +1,127 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Builds BasicHashTables with BuildFrom() on 1, 2, 4 and 8 threads and
+// checks each against a table the same input was inserted into with a
+// loop of Insert: the same Size(), the same entries (the first of equal
+// keys wins) and the same trie shape. The inputs hold duplicate keys,
+// keys whose full hashes collide, std::string keys, fewer entries than
+// one thread builds on its own, and none at all. Prints every mismatch
+// and exits 1 if there was any.
+//
+// usage: build_from_test [elements=200000]
+//
+
+#include "neatlib/basic_hash_table.h"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+size_t failures = 0;
+
+void fail(const string &what) {
+    cout << "MISMATCH: " << what << endl;
+    ++failures;
+}
+
+// groups of 8 neighbouring keys share a full hash, so buckets show up all
+// over the trie, not just in one slot
+struct GroupHash {
+    size_t operator()(uint64_t key) const noexcept { return static_cast<size_t>((key / 8) * 0x9E3779B97F4A7C15ULL); }
+};
+
+// one full hash for every key, so all of them end up in one bucket
+struct ConstantHash {
+    size_t operator()(uint64_t) const noexcept { return 42; }
+};
+
+template<typename K, typename Hash, size_t HASH_LEVEL, size_t ROOT_HASH_LEVEL = HASH_LEVEL>
+using TableOf = neatlib::BasicHashTable<K, uint64_t, Hash, std::equal_to<K>,
+        std::allocator<std::pair<const K, uint64_t>>, HASH_LEVEL, ROOT_HASH_LEVEL>;
+
+uint64_t make(uint64_t r, uint64_t *) { return r; }
+
+string make(uint64_t r, string *) { return "record-" + to_string(r) + "-padded-past-sso"; }
+
+// n pairs of keys drawn from 0 to range - 1, so about n - range of them
+// repeat an earlier key, each with its own value
+template<typename K>
+vector<pair<K, uint64_t>> make_input(size_t n, size_t range, uint64_t seed) {
+    vector<pair<K, uint64_t>> input;
+    mt19937_64 en(seed);
+    for (size_t i = 0; i < n; i++) input.emplace_back(make(en() % range, static_cast<K *>(nullptr)), i);
+    return input;
+}
+
+bool same_shape(const neatlib::TrieStats &a, const neatlib::TrieStats &b) {
+    return a.depth_histogram == b.depth_histogram && a.array_level_histogram == b.array_level_histogram &&
+           a.fill_histogram == b.fill_histogram && a.array_node_count == b.array_node_count &&
+           a.data_node_count == b.data_node_count && a.used_slots == b.used_slots &&
+           a.total_slots == b.total_slots;
+}
+
+template<typename HT>
+void check(const string &name, const vector<pair<typename HT::key_type, uint64_t>> &input) {
+    HT expected;
+    for (const auto &p : input) expected.Insert(p.first, p.second);
+    for (size_t threads : {1, 2, 4, 8}) {
+        string what = name + ", " + to_string(threads) + " threads";
+        HT ht;
+        ht.BuildFrom(input, threads);
+        if (ht.Size() != expected.Size()) {
+            fail(what + ": Size() " + to_string(ht.Size()) + ", expected " + to_string(expected.Size()));
+            continue;
+        }
+        for (const auto &kv : expected) {
+            const uint64_t *v = ht.FindPtr(kv.first);
+            if (v == nullptr || *v != kv.second) {
+                fail(what + ": an entry is missing or not the first of its key");
+                break;
+            }
+        }
+        size_t visited = 0;
+        for (const auto &kv : ht) {
+            ++visited;
+            const uint64_t *v = expected.FindPtr(kv.first);
+            if (v == nullptr || *v != kv.second) {
+                fail(what + ": iteration visits an entry the Insert loop did not make");
+                break;
+            }
+        }
+        if (visited != expected.Size()) fail(what + ": iteration visits " + to_string(visited) + " entries");
+        if (!same_shape(ht.Stats(), expected.Stats())) fail(what + ": the trie is shaped differently");
+        // the built table has to go on working like any other
+        size_t inserted = 0, removed = 0;
+        for (const auto &p : input) inserted += ht.Insert(p.first, p.second + 1);
+        for (const auto &p : input) removed += ht.Remove(p.first);
+        if (inserted != 0 || removed != expected.Size() || ht.Size() != 0 || ht.begin() != ht.end())
+            fail(what + ": Insert or Remove after the build");
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    size_t n = argc >= 2 ? stoull(string(argv[1])) : 200000;
+
+    check<TableOf<uint64_t, std::hash<uint64_t>, 4>>("uint64 keys", make_input<uint64_t>(n, n / 2, 1));
+    check<TableOf<uint64_t, std::hash<uint64_t>, 8>>("uint64 keys, level 8", make_input<uint64_t>(n, n / 2, 2));
+    check<TableOf<uint64_t, std::hash<uint64_t>, 4, 16>>("uint64 keys, root 16",
+                                                         make_input<uint64_t>(n, n / 2, 3));
+    check<TableOf<uint64_t, GroupHash, 4>>("colliding uint64 keys", make_input<uint64_t>(n, n / 2, 4));
+    check<TableOf<uint64_t, ConstantHash, 4>>("one bucket", make_input<uint64_t>(3000, 1000, 5));
+    check<TableOf<string, std::hash<string>, 4>>("string keys", make_input<string>(n / 4, n / 8, 6));
+    check<TableOf<uint64_t, std::hash<uint64_t>, 4>>("below the per thread share", make_input<uint64_t>(1000, 800, 7));
+    check<TableOf<uint64_t, std::hash<uint64_t>, 4>>("one entry", make_input<uint64_t>(1, 1, 8));
+    check<TableOf<uint64_t, std::hash<uint64_t>, 4>>("empty input", make_input<uint64_t>(0, 1, 9));
+
+    if (failures != 0) {
+        cout << failures << " MISMATCHES" << endl;
+        return 1;
+    }
+    cout << "OK" << endl;
+    return 0;
+}
@@ -0,0 +1,158 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Hammers a handful of hot keys with concurrent writers to measure the CAS
+// paths of the concurrent tables.
+//
+// usage: contention_bench [table=lockfree-counters:4:8] [threads=8] [hot=4]
+//                         [seconds=2] [mode=update|churn] [root=0]
+//
+// mode=update only updates keys that are never removed, so every false
+// return is a spurious failure (the locator gave up after FAIL_LIMIT CAS
+// failures). mode=churn mixes Update/Remove/Insert on the same keys, where
+// false is also a legitimate answer; the lockfree-counters table still
+// reports the exact number of kFailLimit hits. root=1 makes all hot keys
+// share their root slot and every level below up to bit 32, so inserts and
+// removes also fight over the same array slots.
+//
+// The thread count is swept in powers of two up to threads=, and every run
+// prints throughput, its ratio to the single-thread run, the failure rate
+// and the per-thread fairness.
+//
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include "bench_util.h"
+
+using namespace std;
+using namespace bench;
+
+struct ThreadCounters {
+    uint64_t ops = 0;
+    uint64_t failed[kOpTypeCount] = {0, 0, 0, 0, 0, 0};
+    uint64_t count[kOpTypeCount] = {0, 0, 0, 0, 0, 0};
+};
+
+template<typename Adapter>
+void hammer_task(Adapter &ht, const vector<uint64_t> &hot, bool churn, atomic<bool> &start,
+                 atomic<bool> &stop, ThreadCounters &result, size_t threadIdx) {
+    default_random_engine en(static_cast<unsigned int>(threadIdx * 7919 + 1));
+    uniform_int_distribution<size_t> pickKey(0, hot.size() - 1);
+    uniform_int_distribution<int> pickOp(0, 2);
+    while (!start.load(memory_order_acquire)) this_thread::yield();
+
+    uint64_t n = 0;
+    while (!stop.load(memory_order_relaxed)) {
+        uint64_t key = hot[pickKey(en)];
+        OpType op = kUpdate;
+        if (churn) {
+            int r = pickOp(en);
+            op = r == 0 ? kUpdate : r == 1 ? kRemove : kInsert;
+        }
+        bool ok = false;
+        switch (op) {
+            case kUpdate:
+                ok = ht.Update(key, n);
+                break;
+            case kRemove:
+                ok = ht.Remove(key);
+                break;
+            case kInsert:
+            default:
+                ok = ht.Insert(key, n);
+                break;
+        }
+        ++result.count[op];
+        if (!ok) ++result.failed[op];
+        ++n;
+    }
+    result.ops = n;
+}
+
+template<typename Adapter>
+double run_once(const string &tableName, const vector<uint64_t> &hot, size_t threadNum,
+                double seconds, bool churn, double baseline) {
+    Adapter ht(threadNum, hot.size() * 1024);
+    for (uint64_t key : hot) ht.Insert(key, 0);
+
+    atomic<bool> start(false), stop(false);
+    vector<ThreadCounters> results(threadNum);
+    vector<thread> threads(threadNum);
+    for (size_t i = 0; i < threadNum; i++)
+        threads[i] = thread(hammer_task<Adapter>, std::ref(ht), std::cref(hot), churn, std::ref(start),
+                            std::ref(stop), std::ref(results[i]), i);
+    auto t1 = clock_type::now();
+    start.store(true, memory_order_release);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true);
+    for (auto &t : threads) t.join();
+    double elapsed = chrono::duration<double>(clock_type::now() - t1).count();
+
+    uint64_t total = 0, minOps = UINT64_MAX, maxOps = 0;
+    double sumSq = 0;
+    ThreadCounters sum;
+    for (const auto &r : results) {
+        total += r.ops;
+        minOps = min(minOps, r.ops);
+        maxOps = max(maxOps, r.ops);
+        sumSq += double(r.ops) * double(r.ops);
+        for (size_t op = 0; op < kOpTypeCount; op++) {
+            sum.count[op] += r.count[op];
+            sum.failed[op] += r.failed[op];
+        }
+    }
+    double throughput = total / elapsed;
+    // Jain's fairness index: 1 when every thread did the same work, 1/n when one thread did all of it
+    double jain = sumSq > 0 ? double(total) * double(total) / (threadNum * sumSq) : 0;
+
+    cout << "TABLE: " << tableName << "  THREADS: " << threadNum << "  HOT KEYS: " << hot.size()
+         << "  MODE: " << (churn ? "churn" : "update") << endl;
+    cout << "  THROUGHPUT: " << fixed << setprecision(0) << throughput << " ops/s"
+         << setprecision(2) << "  (x" << (baseline > 0 ? throughput / baseline : 1.0) << " of 1 thread)" << endl;
+    for (size_t op = 0; op < kOpTypeCount; op++) {
+        if (sum.count[op] == 0) continue;
+        cout << "  " << left << setw(7) << OpName(op) << right << " count=" << sum.count[op]
+             << " failed=" << sum.failed[op] << setprecision(4)
+             << " (" << 100.0 * sum.failed[op] / sum.count[op] << "%"
+             << (churn ? "" : " spurious") << ")" << endl;
+    }
+    cout << "  FAIRNESS: jain=" << setprecision(3) << jain
+         << " min=" << minOps << " max=" << maxOps << endl;
+    ht.Report(cout);
+    return throughput;
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    string table = opt.Get("table", "lockfree-counters:4:8");
+    size_t maxThreads = max<size_t>(1, opt.GetSize("threads", 8));
+    size_t hotCount = max<size_t>(1, opt.GetSize("hot", 4));
+    double seconds = opt.GetDouble("seconds", 2);
+    bool churn = opt.Get("mode", "update") == "churn";
+    bool sameRoot = opt.GetSize("root", 0) != 0;
+
+    vector<uint64_t> hot(hotCount);
+    for (size_t i = 0; i < hotCount; i++)
+        hot[i] = sameRoot ? (i + 1) << 32 : Fnv64(i);
+
+    bool found = DispatchTable(table, [&](auto *tag) {
+        using Adapter = typename remove_pointer<decltype(tag)>::type;
+        if (!Adapter::kConcurrent) {
+            cerr << table << " is not thread safe" << endl;
+            return;
+        }
+        vector<size_t> threadCounts;
+        for (size_t n = 1; n < maxThreads; n *= 2) threadCounts.push_back(n);
+        threadCounts.push_back(maxThreads);
+        double baseline = 0;
+        for (size_t threadNum : threadCounts) {
+            double throughput = run_once<Adapter>(table, hot, threadNum, seconds, churn, baseline);
+            if (threadNum == 1) baseline = throughput;
+        }
+    });
+    if (!found) {
+        cerr << "unknown table: " << table << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// CPU placement for the scalability sweeps. The topology comes from
+// /sys/devices/system/cpu/cpuN/topology, restricted to the CPUs this process
+// may run on. On other systems, or when sysfs is missing, every CPU counts as
+// its own core on socket 0, and pinning is a no-op outside Linux.
+//
+
+#ifndef NEATLIB_CPU_TOPOLOGY_H
+#define NEATLIB_CPU_TOPOLOGY_H
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace bench {
+
+struct CpuInfo {
+    int cpu = 0;
+    int package = 0;
+    int core = 0;
+    int core_rank = 0;  // index of the core inside its package
+    int smt_rank = 0;   // index of the hardware thread inside its core
+};
+
+enum class Pinning {
+    None,     // leave placement to the scheduler
+    Compact,  // fill both SMT siblings of a core, then the next core, then the next socket
+    Scatter   // one thread per core round-robin over the sockets, SMT siblings last
+};
+
+inline Pinning ParsePinning(const std::string &s) {
+    if (s == "compact") return Pinning::Compact;
+    if (s == "scatter") return Pinning::Scatter;
+    if (s == "none") return Pinning::None;
+    throw std::invalid_argument("unknown pinning: " + s);
+}
+
+inline const char *PinningName(Pinning p) {
+    switch (p) {
+        case Pinning::Compact:
+            return "compact";
+        case Pinning::Scatter:
+            return "scatter";
+        default:
+            return "none";
+    }
+}
+
+class CpuTopology {
+public:
+    CpuTopology() {
+        for (int cpu : AllowedCpus()) {
+            CpuInfo info;
+            info.cpu = cpu;
+            info.package = ReadId(cpu, "physical_package_id", 0);
+            info.core = ReadId(cpu, "core_id", cpu);
+            cpus_.push_back(info);
+        }
+        std::sort(cpus_.begin(), cpus_.end(), [](const CpuInfo &a, const CpuInfo &b) {
+            return std::make_tuple(a.package, a.core, a.cpu) < std::make_tuple(b.package, b.core, b.cpu);
+        });
+        std::map<int, int> coresInPackage;
+        for (std::size_t i = 0; i < cpus_.size(); i++) {
+            CpuInfo &c = cpus_[i];
+            bool sameCore = i > 0 && cpus_[i - 1].package == c.package && cpus_[i - 1].core == c.core;
+            if (sameCore) {
+                c.core_rank = cpus_[i - 1].core_rank;
+                c.smt_rank = cpus_[i - 1].smt_rank + 1;
+            } else {
+                c.core_rank = coresInPackage[c.package]++;
+            }
+        }
+        packages_ = coresInPackage.size();
+        for (const auto &p : coresInPackage) cores_ += p.second;
+    }
+
+    std::size_t CpuCount() const { return cpus_.size(); }
+
+    std::size_t CoreCount() const { return cores_; }
+
+    std::size_t PackageCount() const { return packages_; }
+
+    // CPUs in the order threads 0, 1, 2, ... get placed on them
+    std::vector<int> Order(Pinning p) const {
+        std::vector<CpuInfo> sorted(cpus_);
+        if (p == Pinning::Scatter) {
+            std::sort(sorted.begin(), sorted.end(), [](const CpuInfo &a, const CpuInfo &b) {
+                return std::make_tuple(a.smt_rank, a.core_rank, a.package) <
+                       std::make_tuple(b.smt_rank, b.core_rank, b.package);
+            });
+        }
+        std::vector<int> ret;
+        for (const auto &c : sorted) ret.push_back(c.cpu);
+        return ret;
+    }
+
+    // Pins the calling thread to one CPU; false when that is not possible.
+    static bool PinCurrentThread(int cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void) cpu;
+        return false;
+#endif
+    }
+
+private:
+    static std::vector<int> AllowedCpus() {
+        std::vector<int> ret;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &set)) ret.push_back(cpu);
+        }
+#endif
+        if (ret.empty()) {
+            int n = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            for (int cpu = 0; cpu < n; cpu++) ret.push_back(cpu);
+        }
+        return ret;
+    }
+
+    static int ReadId(int cpu, const char *name, int fallback) {
+        std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + name);
+        int id = fallback;
+        if (!(in >> id)) return fallback;
+        return id;
+    }
+
+    std::vector<CpuInfo> cpus_;
+    std::size_t packages_ = 0;
+    std::size_t cores_ = 0;
+};
+
+} // namespace bench
+
+#endif //NEATLIB_CPU_TOPOLOGY_H
@@ -1,6 +1,14 @@
 //
 // Created by jiahua on 2019/3/19.
 //
+// Without arguments every phase (insert, get, update, remove) runs on its
+// own with 12 threads. mode=mixed instead runs readers and writers at the
+// same time and reports reader latency with and without the writers:
+//
+// usage: ebr_ht_performance_test mode=mixed [table=lockfree:4:8] [threads=12]
+//                                [write_ratio=0.25] [remove_ratio=0] [seconds=5]
+//                                [records=1000000] [ordered=0]
+//
 #include <atomic>
 #include <memory>
 #include <iostream>
@@ -10,6 +18,8 @@
 #include <random>
 #include "../neatlib/lock_free_hash_table.h"
 #include <functional>
+#include <type_traits>
+#include "mixed_runner.h"
 
 using namespace std;
 using namespace chrono;
@@ -43,7 +53,65 @@ void remove_task(HT &ht, vector<size_t> &keys, size_t threadIdx) {
     }
 }
 
-int main() {
+template<typename Adapter>
+void run_mixed(const string &tableName, bench::MixedConfig cfg) {
+    // the same readers alone first, so the writers' share of the read latency shows up
+    bench::MixedConfig alone = cfg;
+    alone.writers = 0;
+    bench::MixedResult base, mixed;
+    {
+        Adapter ht(alone.readers, alone.records);
+        base = bench::RunMixed(ht, alone);
+    }
+    Adapter ht(cfg.readers + cfg.writers, cfg.records);
+    mixed = bench::RunMixed(ht, cfg);
+
+    cout << "TABLE: " << tableName << "  READERS: " << cfg.readers << "  WRITERS: " << cfg.writers
+         << "  RECORDS: " << cfg.records << "  REMOVE RATIO: " << cfg.remove_ratio << endl;
+    cout << "READERS ALONE:   " << fixed << setprecision(0) << base.ReadThroughput() << " reads/s" << endl;
+    bench::PrintLatency(cout, "GET", base.read_latency);
+    cout << "WITH WRITERS:    " << mixed.ReadThroughput() << " reads/s, "
+         << mixed.WriteThroughput() << " writes/s, " << mixed.read_misses << " read misses" << endl;
+    bench::PrintLatency(cout, "GET", mixed.read_latency);
+    bench::PrintLatency(cout, "WRITE", mixed.write_latency);
+    cout << setprecision(2) << "READ p99 x" << double(mixed.read_latency.Percentile(99)) /
+                                              max<uint64_t>(1, base.read_latency.Percentile(99))
+         << "  p999 x" << double(mixed.read_latency.Percentile(99.9)) /
+                         max<uint64_t>(1, base.read_latency.Percentile(99.9)) << endl;
+    ht.Report(cout);
+}
+
+int mixed_main(const bench::Options &opt) {
+    string table = opt.Get("table", "lockfree:4:8");
+    size_t threads = max<size_t>(2, opt.GetSize("threads", threadNum));
+    double writeRatio = min(1.0, max(0.0, opt.GetDouble("write_ratio", 0.25)));
+    bench::MixedConfig cfg;
+    cfg.writers = min(threads - 1, max<size_t>(1, static_cast<size_t>(threads * writeRatio + 0.5)));
+    cfg.readers = threads - cfg.writers;
+    cfg.records = max<size_t>(1, opt.GetSize("records", 1000000));
+    cfg.seconds = opt.GetDouble("seconds", 5);
+    cfg.remove_ratio = opt.GetDouble("remove_ratio", 0);
+    cfg.ordered = opt.GetSize("ordered", 0) != 0;
+
+    bool found = bench::DispatchTable(table, [&](auto *tag) {
+        using Adapter = typename remove_pointer<decltype(tag)>::type;
+        if (!Adapter::kConcurrent) {
+            cerr << table << " is not thread safe" << endl;
+            return;
+        }
+        run_mixed<Adapter>(table, cfg);
+    });
+    if (!found) {
+        cerr << "unknown table: " << table << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, const char *argv[]) {
+    bench::Options opt(argc, argv);
+    if (opt.Get("mode", "phases") == "mixed") return mixed_main(opt);
+
     vector<size_t> keys(TOTAL_ELEMENTS, 0);
     vector<thread> threads(threadNum);
     neatlib::LockFreeHashTable<size_t,
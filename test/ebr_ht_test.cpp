@@ -3,6 +3,7 @@
 //
 #include "../neatlib/lock_free_hash_table.h"
 #include <iostream>
+#include <thread>
 using namespace std;
 
 int main() {
@@ -19,5 +20,25 @@ int main() {
     } catch(const std::out_of_range &e) {
         cout << e.what() << endl;
     }
-}
 
+    // An operation inside EnterEpoch()/LeaveEpoch() must not end the outer
+    // section early, nor leave the thread protected after it. The epoch
+    // ignores thread id 0 (this thread) when computing what is safe to
+    // reclaim, so the check runs on a thread of its own.
+    FASTER::core::EpochTelemetry telemetry;
+    std::thread worker([&] {
+        ht.EnterEpoch();
+        ht.Get(100);
+        ht.LeaveEpoch();
+        for (int i = 0; i < 100; i++) ht.Remove(i);
+        telemetry = ht.GetEpochTelemetry();
+    });
+    worker.join();
+    cout << "retired " << telemetry.retired << ", reclaimed " << telemetry.reclaimed << endl;
+    // only the node retired last may still wait for a later epoch
+    if (telemetry.reclaimed + 1 < telemetry.retired) {
+        cout << "retired nodes are not reclaimed after a nested EnterEpoch()" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Runs the basic_ht_test phases on the trie and on the flat table with the
+// same keys, checks both give the same answers and prints both timings.
+//
+// usage: flat_ht_test [elements] [range]
+//
+
+#include "neatlib/basic_hash_table.h"
+#include "neatlib/flat_hash_table.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace chrono;
+
+size_t RANGE = 20000000;
+size_t TOTAL_ELEMENTS = 10000000;
+
+struct Result {
+    long long insert_ms, get_ms, update_ms, remove_ms;
+    size_t inserted, got, updated, removed, left;
+};
+
+template<typename HT>
+Result run(HT &ht, const vector<size_t> &keys) {
+    Result r{0, 0, 0, 0, 0, 0, 0, 0, 0};
+    auto t1 = steady_clock::now();
+    for (const auto &i : keys)
+        if (ht.Insert(i, 10))
+            ++r.inserted;
+    auto t2 = steady_clock::now();
+    for (const auto &i : keys)
+        if (ht.Get(i).second == 10)
+            ++r.got;
+    auto t3 = steady_clock::now();
+    for (const auto &i : keys)
+        if (ht.Update(i, 20))
+            ++r.updated;
+    auto t4 = steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i += 2)
+        if (ht.Remove(keys[i]))
+            ++r.removed;
+    auto t5 = steady_clock::now();
+    for (size_t i = 1; i < keys.size(); i += 2)
+        if (ht.Find(keys[i]) == nullptr || ht.Get(keys[i]).second != 20)
+            ++r.left;
+    r.insert_ms = duration_cast<milliseconds>(t2 - t1).count();
+    r.get_ms = duration_cast<milliseconds>(t3 - t2).count();
+    r.update_ms = duration_cast<milliseconds>(t4 - t3).count();
+    r.remove_ms = duration_cast<milliseconds>(t5 - t4).count();
+    return r;
+}
+
+void print(const char *name, const Result &r, size_t size) {
+    cout << name << endl;
+    cout << "INSERTION TIME: " << r.insert_ms << "  " << r.inserted << endl;
+    cout << "GETTING TIME:   " << r.get_ms << "  " << r.got << endl;
+    cout << "UPDATING TIME:  " << r.update_ms << "  " << r.updated << endl;
+    cout << "REMOVING TIME:  " << r.remove_ms << "  " << size << "  " << r.removed << endl;
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc >= 2) TOTAL_ELEMENTS = stoull(string(argv[1]));
+    if (argc >= 3) RANGE = stoull(string(argv[2]));
+    vector<size_t> keys(TOTAL_ELEMENTS, 0);
+    default_random_engine en(static_cast<unsigned int>(steady_clock::now().time_since_epoch().count()));
+    uniform_int_distribution<size_t> dis(0, RANGE);
+    for (auto &i : keys) i = dis(en);
+
+    neatlib::BasicHashTable<size_t, size_t, std::hash<size_t>, std::equal_to<size_t>,
+            std::allocator<std::pair<const size_t, size_t>>, 8> bht;
+    neatlib::FlatHashTable<size_t, size_t> fht;
+    Result br = run(bht, keys);
+    Result fr = run(fht, keys);
+    print("BASIC HASH TABLE", br, bht.Size());
+    print("FLAT HASH TABLE", fr, fht.Size());
+
+    bool same = br.inserted == fr.inserted && br.got == fr.got && br.updated == fr.updated &&
+                br.removed == fr.removed && bht.Size() == fht.Size() && br.left == fr.left;
+    if (!same) {
+        cout << "MISMATCH" << endl;
+        return 1;
+    }
+    return 0;
+}
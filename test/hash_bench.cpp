@@ -0,0 +1,134 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Hash policies: raw throughput of std::hash against neatlib's MixHash /
+// StringHash / HashBatch, then the shape of a BasicHashTable (entries per
+// level, node memory) and its lookup speed under each policy for
+// sequential, strided and random keys.
+//
+// usage: hash_bench [n=1000000] [lookups=1000000] [stride=4096]
+//
+// stride= is the step of the strided keys, like ids handed out in blocks.
+//
+#include <random>
+#include <string>
+#include "bench_util.h"
+
+using namespace std;
+using namespace bench;
+
+template<typename Key>
+using BH = neatlib::BasicHashTable<Key, uint64_t, std::hash<Key>, std::equal_to<Key>,
+        std::allocator<std::pair<const Key, uint64_t>>, 4>;
+
+template<typename Key>
+using MixBH = neatlib::BasicHashTable<Key, uint64_t, neatlib::MixHash<Key>, std::equal_to<Key>,
+        std::allocator<std::pair<const Key, uint64_t>>, 4>;
+
+// keeps the hashes and lookups from being optimized away
+volatile size_t g_sink = 0;
+
+template<typename F>
+double ns_per_key(size_t n, size_t rounds, F &&f) {
+    uint64_t start = NowNs();
+    for (size_t r = 0; r < rounds; r++) f();
+    return double(NowNs() - start) / (n * rounds);
+}
+
+void hash_throughput(size_t n) {
+    vector<uint64_t> keys(n);
+    mt19937_64 en(1);
+    for (auto &k : keys) k = en();
+    vector<size_t> out(n);
+    size_t rounds = max<size_t>(1, 20000000 / n);
+    cout << "HASH THROUGHPUT (ns/key)" << endl;
+    cout << "  uint64 std::hash:        " << fixed << setprecision(2) << ns_per_key(n, rounds, [&] {
+        for (size_t i = 0; i < n; i++) out[i] = std::hash<uint64_t>()(keys[i]);
+        g_sink = g_sink ^ out[n - 1];
+    }) << endl;
+    cout << "  uint64 MixHash:          " << ns_per_key(n, rounds, [&] {
+        neatlib::MixHash<uint64_t> h;
+        for (size_t i = 0; i < n; i++) out[i] = h(keys[i]);
+        g_sink = g_sink ^ out[n - 1];
+    }) << endl;
+    cout << "  uint64 HashBatch(Mix):   " << ns_per_key(n, rounds, [&] {
+        neatlib::HashBatch(neatlib::MixHash<uint64_t>(), keys.data(), n, out.data());
+        g_sink = g_sink ^ out[n - 1];
+    }) << endl;
+    for (size_t len : {8, 24, 64, 256}) {
+        vector<string> strs(n / 4 + 1);
+        for (auto &s : strs) {
+            s.resize(len);
+            for (auto &c : s) c = static_cast<char>('a' + en() % 26);
+        }
+        size_t m = strs.size();
+        cout << "  string" << setw(4) << len << " std::hash:    " << ns_per_key(m, rounds, [&] {
+            for (size_t i = 0; i < m; i++) out[i] = std::hash<string>()(strs[i]);
+            g_sink = g_sink ^ out[m - 1];
+        }) << endl;
+        cout << "  string" << setw(4) << len << " StringHash:   " << ns_per_key(m, rounds, [&] {
+            neatlib::StringHash h;
+            for (size_t i = 0; i < m; i++) out[i] = h(strs[i]);
+            g_sink = g_sink ^ out[m - 1];
+        }) << endl;
+    }
+}
+
+template<typename HT>
+void trie_shape(const string &name, const vector<uint64_t> &keys, size_t lookups) {
+    HT ht(keys.size());
+    uint64_t start = NowNs();
+    for (size_t i = 0; i < keys.size(); i++) ht.Insert(keys[i], i);
+    double insert_ns = double(NowNs() - start) / keys.size();
+
+    mt19937_64 en(7);
+    vector<uint64_t> probe(lookups);
+    for (auto &k : probe) k = keys[en() % keys.size()];
+    start = NowNs();
+    uint64_t sink = 0;
+    for (uint64_t k : probe) sink += *ht.FindPtr(k);
+    g_sink = sink;
+    double find_ns = double(NowNs() - start) / lookups;
+    vector<const typename HT::value_type *> out(lookups);
+    start = NowNs();
+    ht.FindBatch(probe.data(), lookups, out.data());
+    double batch_ns = double(NowNs() - start) / lookups;
+
+    neatlib::TrieStats stats = ht.Stats();
+    cout << "  " << left << setw(18) << name << right << fixed << setprecision(2)
+         << setw(8) << stats.AverageDepth() << setw(6) << stats.depth_histogram.size() - 1
+         << setw(10) << stats.array_node_count << setw(8) << stats.node_bytes / (1024 * 1024)
+         << setprecision(1) << setw(10) << insert_ns << setw(10) << find_ns << setw(10) << batch_ns
+         << "   ";
+    for (size_t l = 0; l < stats.depth_histogram.size(); l++)
+        cout << (l ? " " : "") << stats.depth_histogram[l] * 100 / keys.size() << "%";
+    cout << endl;
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    size_t n = max<size_t>(1, opt.GetSize("n", 1000000));
+    size_t lookups = max<size_t>(1, opt.GetSize("lookups", 1000000));
+    uint64_t stride = opt.GetSize("stride", 4096);
+
+    hash_throughput(n);
+
+    vector<uint64_t> seq(n), strided(n), random(n);
+    mt19937_64 en(3);
+    for (size_t i = 0; i < n; i++) {
+        seq[i] = i;
+        strided[i] = i * stride;
+        random[i] = en();
+    }
+    cout << endl << "BASIC:4 TRIE SHAPE (n=" << n << ")" << endl;
+    cout << "  " << left << setw(18) << "KEYS/HASH" << right << setw(8) << "AVG LVL" << setw(6) << "MAX"
+         << setw(10) << "ARRAYS" << setw(8) << "MB" << setw(10) << "INS ns" << setw(10) << "FIND ns"
+         << setw(10) << "BATCH ns" << "   ENTRIES PER LEVEL" << endl;
+    trie_shape<BH<uint64_t>>("seq/std", seq, lookups);
+    trie_shape<MixBH<uint64_t>>("seq/mix", seq, lookups);
+    trie_shape<BH<uint64_t>>("strided/std", strided, lookups);
+    trie_shape<MixBH<uint64_t>>("strided/mix", strided, lookups);
+    trie_shape<BH<uint64_t>>("random/std", random, lookups);
+    trie_shape<MixBH<uint64_t>>("random/mix", random, lookups);
+    return 0;
+}
@@ -0,0 +1,99 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Lookups of std::string keys that arrive as C strings (off the wire, out
+// of a parse buffer): building a std::string for every lookup against the
+// heterogeneous lookup of a table with StringHash and std::equal_to<>.
+// Counts the heap allocations the lookups make along with their speed.
+//
+// usage: hetero_bench [n=1000000] [lookups=1000000] [len=32]
+//
+// len= is the key length; libstdc++ keeps strings of up to 15 characters
+// inside the object, so shorter keys do not allocate either way.
+//
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include "bench_util.h"
+
+using namespace std;
+using namespace bench;
+
+std::size_t allocations = 0;
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    void *ret = std::malloc(size ? size : 1);
+    if (ret == nullptr) throw std::bad_alloc();
+    return ret;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+using KeyedHT = neatlib::BasicHashTable<string, uint64_t, neatlib::StringHash>;
+using TransparentHT = neatlib::BasicHashTable<string, uint64_t, neatlib::StringHash, std::equal_to<>>;
+
+// the key of record i, padded with letters to len characters
+string make_key(size_t i, size_t len) {
+    string ret = to_string(i);
+    ret.append(len > ret.size() ? len - ret.size() : 0, 'k');
+    return ret;
+}
+
+// the lookups of f over probe: ns per lookup, allocations per lookup and
+// how many were found
+template<typename F>
+void run(const string &name, const vector<const char *> &probe, F &&f) {
+    size_t found = 0;
+    size_t before = allocations;
+    uint64_t start = NowNs();
+    for (const char *key : probe) found += f(key);
+    double ns = double(NowNs() - start) / probe.size();
+    double allocs = double(allocations - before) / probe.size();
+    cout << "  " << left << setw(28) << name << right << fixed << setprecision(1) << setw(8) << ns
+         << setprecision(2) << setw(12) << allocs << setw(10) << found << endl;
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    size_t n = max<size_t>(1, opt.GetSize("n", 1000000));
+    size_t lookups = max<size_t>(1, opt.GetSize("lookups", 1000000));
+    size_t len = opt.GetSize("len", 32);
+
+    vector<string> keys(n);
+    for (size_t i = 0; i < n; i++) keys[i] = make_key(i, len);
+    KeyedHT keyed(n);
+    TransparentHT transparent(n);
+    for (size_t i = 0; i < n; i++) {
+        keyed.Insert(keys[i], i);
+        transparent.Insert(keys[i], i);
+    }
+
+    mt19937_64 en(5);
+    vector<const char *> probe(lookups);
+    for (auto &p : probe) p = keys[en() % n].c_str();
+
+    cout << "STRING KEYS: n=" << n << " len=" << len << " lookups=" << lookups << endl;
+    cout << "  " << left << setw(28) << "LOOKUP" << right << setw(8) << "ns" << setw(12) << "ALLOCS/OP"
+         << setw(10) << "FOUND" << endl;
+    run("FindPtr(std::string(key))", probe, [&](const char *key) {
+        return keyed.FindPtr(string(key)) != nullptr;
+    });
+    run("FindPtr(key) transparent", probe, [&](const char *key) {
+        return transparent.FindPtr(key) != nullptr;
+    });
+    run("Contains(std::string(key))", probe, [&](const char *key) {
+        return keyed.Contains(string(key));
+    });
+    run("Contains(key) transparent", probe, [&](const char *key) {
+        return transparent.Contains(key);
+    });
+    return 0;
+}
@@ -0,0 +1,181 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Bytes per entry of every table next to std::unordered_map and a
+// mutex-sharded unordered_map.
+//
+// usage: memory_bench [n=1M,10M] [key=4|8] [value=8|32|128]
+//                     [table=basic:4,basic:8,basic:4:16,flat,concurrent:4:8,lockfree:4:8,unordered_map,sharded]
+//
+// Every (table, n) run happens in a forked child on Linux, so the RSS and
+// heap numbers of one table are not polluted by memory another table freed
+// but the allocator kept.
+//
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include "bench_util.h"
+
+#ifdef __linux__
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace bench;
+
+template<size_t N>
+struct Blob {
+    char data[N];
+
+    Blob() : data() {}
+
+    explicit Blob(uint64_t v) : data() { memcpy(data, &v, sizeof(v) < N ? sizeof(v) : N); }
+};
+
+template<typename V>
+V make_value(uint64_t v) { return V(v); }
+
+template<>
+uint64_t make_value<uint64_t>(uint64_t v) { return v; }
+
+// bijective scramblers, so n distinct record numbers give n distinct keys
+inline uint32_t make_key(uint64_t i, uint32_t *) { return static_cast<uint32_t>(i) * 2654435761u; }
+
+inline uint64_t make_key(uint64_t i, uint64_t *) { return MakeKey(i); }
+
+struct MemoryUsage {
+    size_t rss = 0;
+    size_t heap = 0;
+};
+
+MemoryUsage current_usage() {
+    MemoryUsage ret;
+    ret.rss = ResidentBytes();
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    ret.heap = mi.uordblks + mi.hblkhd;
+#endif
+    return ret;
+}
+
+template<typename K, typename V>
+class ShardedMap {
+private:
+    static constexpr size_t kShards = 64;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<K, V> map;
+    };
+
+public:
+    bool Insert(const K &key, const V &value) {
+        Shard &s = shards_[std::hash<K>()(key) % kShards];
+        std::lock_guard<std::mutex> guard(s.mutex);
+        return s.map.emplace(key, value).second;
+    }
+
+private:
+    Shard shards_[kShards];
+};
+
+template<typename K, typename V>
+struct UnorderedMap {
+    std::unordered_map<K, V> map;
+
+    bool Insert(const K &key, const V &value) { return map.emplace(key, value).second; }
+};
+
+// the neatlib tables can also count their own node bytes through Stats()
+template<typename HT>
+auto table_bytes(HT &ht, int) -> decltype(ht.Stats().TotalBytes()) { return ht.Stats().TotalBytes(); }
+
+template<typename HT>
+size_t table_bytes(HT &, long) { return 0; }
+
+template<typename HT, typename K, typename V, typename Make>
+void measure(const string &name, size_t n, Make make) {
+    MemoryUsage before = current_usage();
+    auto t1 = clock_type::now();
+    unique_ptr<HT> ht(make());
+    for (uint64_t i = 0; i < n; i++)
+        ht->Insert(make_key(i, static_cast<K *>(nullptr)), make_value<V>(i));
+    auto t2 = clock_type::now();
+    MemoryUsage after = current_usage();
+    size_t own = table_bytes(*ht, 0);
+
+    cout << left << setw(16) << name << right
+         << setw(6) << sizeof(K) << setw(7) << sizeof(V) << setw(12) << n
+         << setw(12) << fixed << setprecision(1) << double(SignedDelta(after.rss, before.rss)) / n
+         << setw(12) << double(SignedDelta(after.heap, before.heap)) / n
+         << setw(12) << (own ? double(own) / n : 0.0)
+         << setw(10) << setprecision(2) << chrono::duration<double>(t2 - t1).count() << endl;
+}
+
+template<typename K, typename V>
+void run_table(const string &name, size_t n) {
+    using BH4 = neatlib::BasicHashTable<K, V, std::hash<K>, std::equal_to<K>,
+            std::allocator<std::pair<const K, V>>, 4>;
+    using BH8 = neatlib::BasicHashTable<K, V, std::hash<K>, std::equal_to<K>,
+            std::allocator<std::pair<const K, V>>, 8>;
+    using BH416 = neatlib::BasicHashTable<K, V, std::hash<K>, std::equal_to<K>,
+            std::allocator<std::pair<const K, V>>, 4, 16>;
+    using FH = neatlib::FlatHashTable<K, V>;
+    using CH = neatlib::ConcurrentHashTable<K, V, std::hash<K>, 4, 8>;
+    using LF = neatlib::LockFreeHashTable<K, V, std::hash<K>, 4, 8>;
+
+    if (name == "basic:4") measure<BH4, K, V>(name, n, [n] { return new BH4(n); });
+    else if (name == "basic:8") measure<BH8, K, V>(name, n, [n] { return new BH8(n); });
+    else if (name == "basic:4:16") measure<BH416, K, V>(name, n, [n] { return new BH416(n); });
+    else if (name == "flat") measure<FH, K, V>(name, n, [n] { return new FH(n); });
+    else if (name == "concurrent:4:8") measure<CH, K, V>(name, n, [] { return new CH(); });
+    else if (name == "lockfree:4:8") measure<LF, K, V>(name, n, [n] { return new LF(1, n); });
+    else if (name == "unordered_map")
+        measure<UnorderedMap<K, V>, K, V>(name, n, [] { return new UnorderedMap<K, V>(); });
+    else if (name == "sharded") measure<ShardedMap<K, V>, K, V>(name, n, [] { return new ShardedMap<K, V>(); });
+    else cerr << "unknown table: " << name << endl;
+}
+
+template<typename K>
+void run_key(const string &name, size_t n, size_t valueBytes) {
+    if (valueBytes == 8) run_table<K, uint64_t>(name, n);
+    else if (valueBytes == 32) run_table<K, Blob<32>>(name, n);
+    else if (valueBytes == 128) run_table<K, Blob<128>>(name, n);
+    else cerr << "unsupported value size: " << valueBytes << endl;
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    vector<string> ns = Split(opt.Get("n", "1000000"));
+    vector<string> tables = Split(opt.Get("table",
+                                          "basic:4,basic:8,basic:4:16,flat,concurrent:4:8,lockfree:4:8,unordered_map,sharded"));
+    size_t keyBytes = opt.GetSize("key", 8);
+    size_t valueBytes = opt.GetSize("value", 8);
+
+    cout << left << setw(16) << "TABLE" << right << setw(6) << "KEY" << setw(7) << "VALUE"
+         << setw(12) << "N" << setw(12) << "RSS/ENTRY" << setw(12) << "HEAP/ENTRY"
+         << setw(12) << "STATS/ENTRY" << setw(10) << "LOAD(s)" << endl;
+    for (const auto &nStr : ns) {
+        size_t n = ParseSize(nStr);
+        for (const auto &t : tables) {
+#ifdef __linux__
+            cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                if (keyBytes == 4) run_key<uint32_t>(t, n, valueBytes);
+                else run_key<uint64_t>(t, n, valueBytes);
+                cout.flush();
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+#else
+            if (keyBytes == 4) run_key<uint32_t>(t, n, valueBytes);
+            else run_key<uint64_t>(t, n, valueBytes);
+#endif
+        }
+    }
+    return 0;
+}
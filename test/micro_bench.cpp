@@ -0,0 +1,149 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Single-threaded Get/Insert/Update/Remove microbenchmarks with hardware
+// counters per operation.
+//
+// usage: micro_bench [table=all|basic:4|...] [records=1000000] [ops=1000000]
+//                    [ordered=0] [batch=32]
+//
+// Each table is preloaded with records keys, then every operation type runs
+// ops times over shuffled keys inside one counter region. The numbers are
+// region totals divided by ops: cycles, instructions (and IPC), L1d/LLC/dTLB
+// read misses and branch misses per operation. Counters that cannot be
+// opened print as "n/a". Tables with FindBatch also run the Get keys through
+// it in batches of batch= keys ("Batch").
+//
+#include <algorithm>
+#include <type_traits>
+#include "bench_util.h"
+#include "perf_counters.h"
+
+using namespace std;
+using namespace bench;
+
+struct Region {
+    string name;
+    double seconds;
+    size_t ops;
+    PerfCounters::Sample sample;
+};
+
+void print_header() {
+    cout << left << setw(24) << "TABLE" << setw(8) << "OP" << right << setw(10) << "ns/op"
+         << setw(10) << "IPC";
+    for (size_t e = 0; e < PerfCounters::kEventCount; e++)
+        if (e != PerfCounters::kInstructions) cout << setw(13) << PerfCounters::EventName(e);
+    cout << endl;
+}
+
+void print_region(const string &table, const Region &r) {
+    const auto &s = r.sample;
+    cout << left << setw(24) << table << setw(8) << r.name << right << fixed << setprecision(1)
+         << setw(10) << r.seconds * 1e9 / r.ops;
+    if (s.valid[PerfCounters::kCycles] && s.valid[PerfCounters::kInstructions] && s.value[PerfCounters::kCycles] > 0)
+        cout << setw(10) << setprecision(2) << s.value[PerfCounters::kInstructions] / s.value[PerfCounters::kCycles];
+    else
+        cout << setw(10) << "n/a";
+    for (size_t e = 0; e < PerfCounters::kEventCount; e++) {
+        if (e == PerfCounters::kInstructions) continue;
+        if (s.valid[e]) cout << setw(13) << setprecision(3) << s.value[e] / r.ops;
+        else cout << setw(13) << "n/a";
+    }
+    cout << endl;
+}
+
+// keeps the Get loop from being optimized away
+volatile uint64_t g_sink = 0;
+
+template<typename F>
+Region measure(PerfCounters &counters, const string &name, const vector<uint64_t> &keys, F f) {
+    Region r;
+    r.name = name;
+    r.ops = keys.size();
+    auto t1 = clock_type::now();
+    counters.Start();
+    for (uint64_t key : keys) f(key);
+    r.sample = counters.Stop();
+    r.seconds = chrono::duration<double>(clock_type::now() - t1).count();
+    return r;
+}
+
+// only some tables can look up many keys at once
+template<typename HT>
+auto find_batch(HT &ht, const uint64_t *keys, size_t n, int)
+-> decltype(ht.FindBatch(keys, n, static_cast<const typename HT::value_type **>(nullptr))) {
+    const typename HT::value_type *out[256];
+    size_t ret = 0;
+    for (size_t base = 0; base < n; base += 256)
+        ret += ht.FindBatch(keys + base, min<size_t>(256, n - base), out);
+    return ret;
+}
+
+template<typename HT>
+size_t find_batch(HT &, const uint64_t *, size_t, long) { return static_cast<size_t>(-1); }
+
+template<typename Adapter>
+void run_table(PerfCounters &counters, const string &table, size_t records, size_t ops, bool ordered,
+               size_t batch) {
+    Adapter ht(1, records + ops);
+    default_random_engine en(42);
+    auto keyOf = [ordered](uint64_t rec) { return ordered ? rec : Fnv64(rec); };
+
+    for (uint64_t i = 0; i < records; i++) ht.Insert(keyOf(i), i);
+
+    vector<uint64_t> hit(ops), fresh(ops);
+    uniform_int_distribution<uint64_t> dis(0, records - 1);
+    for (auto &k : hit) k = keyOf(dis(en));
+    for (size_t i = 0; i < ops; i++) fresh[i] = keyOf(records + i);
+    shuffle(fresh.begin(), fresh.end(), en);
+    vector<uint64_t> removed(fresh);
+    shuffle(removed.begin(), removed.end(), en);
+
+    uint64_t sink = 0;
+    vector<Region> regions;
+    regions.push_back(measure(counters, "Get", hit, [&](uint64_t k) {
+        uint64_t v = 0;
+        ht.Read(k, v);
+        sink += v;
+    }));
+    if (find_batch(ht.Table(), hit.data(), 0, 0) != static_cast<size_t>(-1)) {
+        vector<uint64_t> batches;
+        for (size_t i = 0; i < hit.size(); i += batch) batches.push_back(i);
+        Region r = measure(counters, "Batch", batches, [&](uint64_t i) {
+            sink += find_batch(ht.Table(), hit.data() + i, min<size_t>(batch, hit.size() - i), 0);
+        });
+        r.ops = hit.size();
+        regions.push_back(r);
+    }
+    regions.push_back(measure(counters, "Insert", fresh, [&](uint64_t k) { ht.Insert(k, k); }));
+    regions.push_back(measure(counters, "Update", hit, [&](uint64_t k) { ht.Update(k, k); }));
+    regions.push_back(measure(counters, "Remove", removed, [&](uint64_t k) { ht.Remove(k); }));
+    g_sink = sink;
+    for (const auto &r : regions) print_region(table, r);
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    string tableOpt = opt.Get("table", "all");
+    size_t records = max<size_t>(1, opt.GetSize("records", 1000000));
+    size_t ops = max<size_t>(1, opt.GetSize("ops", 1000000));
+    bool ordered = opt.GetSize("ordered", 0) != 0;
+    size_t batch = max<size_t>(1, opt.GetSize("batch", 32));
+
+    PerfCounters counters;
+    if (!counters.Available())
+        cerr << "# perf_event_open unavailable, printing timings only" << endl;
+    print_header();
+    vector<string> tables = tableOpt == "all" ? TableNames() : vector<string>{tableOpt};
+    for (const auto &t : tables) {
+        bool found = DispatchTable(t, [&](auto *tag) {
+            run_table<typename remove_pointer<decltype(tag)>::type>(counters, t, records, ops, ordered, batch);
+        });
+        if (!found) {
+            cerr << "unknown table: " << t << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Readers and writers running against one table at the same time for a
+// fixed duration. Readers only Get, writers Update (every update retires the
+// replaced node and bumps the epoch of the lock free table) and optionally
+// Remove + re-Insert their keys, so reader latency is measured while
+// reclamation is going on underneath.
+//
+
+#ifndef NEATLIB_MIXED_RUNNER_H
+#define NEATLIB_MIXED_RUNNER_H
+
+#include <thread>
+#include "bench_util.h"
+
+namespace bench {
+
+struct MixedConfig {
+    std::size_t readers = 1;
+    std::size_t writers = 1;
+    std::size_t records = 0;
+    double seconds = 1;
+    double remove_ratio = 0;  // share of writer ops that remove a key and insert it back
+    bool ordered = false;
+};
+
+struct MixedResult {
+    LatencyHistogram read_latency;
+    LatencyHistogram write_latency;
+    uint64_t read_ops = 0;
+    uint64_t read_misses = 0;
+    uint64_t write_ops = 0;
+    double seconds = 0;
+
+    double ReadThroughput() const { return seconds > 0 ? read_ops / seconds : 0; }
+
+    double WriteThroughput() const { return seconds > 0 ? write_ops / seconds : 0; }
+};
+
+namespace detail {
+
+struct MixedThreadResult {
+    LatencyHistogram latency;
+    uint64_t ops = 0;
+    uint64_t misses = 0;
+};
+
+inline uint64_t MixedKey(const MixedConfig &cfg, uint64_t rec) { return cfg.ordered ? rec : Fnv64(rec); }
+
+template<typename Adapter>
+void MixedReader(Adapter &ht, const MixedConfig &cfg, const std::atomic<bool> &start,
+                 const std::atomic<bool> &stop, MixedThreadResult &result, std::size_t threadIdx) {
+    std::default_random_engine en(static_cast<unsigned int>(threadIdx * 7919 + 1));
+    std::uniform_int_distribution<uint64_t> dis(0, cfg.records - 1);
+    while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+    while (!stop.load(std::memory_order_relaxed)) {
+        uint64_t key = MixedKey(cfg, dis(en)), value = 0;
+        uint64_t t1 = NowNs();
+        bool ok = ht.Read(key, value);
+        result.latency.Record(NowNs() - t1);
+        if (!ok) ++result.misses;
+        ++result.ops;
+    }
+}
+
+// Writer threadIdx owns the records congruent to threadIdx modulo the writer
+// count, so a removed key is only ever inserted back by its owner.
+template<typename Adapter>
+void MixedWriter(Adapter &ht, const MixedConfig &cfg, const std::atomic<bool> &start,
+                 const std::atomic<bool> &stop, MixedThreadResult &result, std::size_t threadIdx) {
+    std::default_random_engine en(static_cast<unsigned int>(threadIdx * 104729 + 7));
+    std::size_t owned = (cfg.records - threadIdx + cfg.writers - 1) / cfg.writers;
+    if (owned == 0) return;
+    std::uniform_int_distribution<uint64_t> dis(0, owned - 1);
+    std::uniform_real_distribution<double> pick(0.0, 1.0);
+    while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+    while (!stop.load(std::memory_order_relaxed)) {
+        uint64_t rec = dis(en) * cfg.writers + threadIdx;
+        uint64_t key = MixedKey(cfg, rec);
+        uint64_t t1 = NowNs();
+        if (cfg.remove_ratio > 0 && pick(en) < cfg.remove_ratio) {
+            ht.Remove(key);
+            ht.Insert(key, rec);
+        } else {
+            ht.Update(key, result.ops);
+        }
+        result.latency.Record(NowNs() - t1);
+        ++result.ops;
+    }
+}
+
+} // namespace detail
+
+// Loads cfg.records keys, then runs cfg.readers readers next to cfg.writers
+// writers for cfg.seconds. ht must be freshly constructed for
+// readers + writers threads.
+template<typename Adapter>
+MixedResult RunMixed(Adapter &ht, const MixedConfig &cfg) {
+    for (uint64_t i = 0; i < cfg.records; i++) ht.Insert(detail::MixedKey(cfg, i), i);
+
+    std::atomic<bool> start(false), stop(false);
+    std::size_t threadNum = cfg.readers + cfg.writers;
+    std::vector<detail::MixedThreadResult> results(threadNum);
+    std::vector<std::thread> threads(threadNum);
+    for (std::size_t i = 0; i < cfg.readers; i++)
+        threads[i] = std::thread(detail::MixedReader<Adapter>, std::ref(ht), std::cref(cfg), std::cref(start),
+                                 std::cref(stop), std::ref(results[i]), i);
+    for (std::size_t i = 0; i < cfg.writers; i++)
+        threads[cfg.readers + i] = std::thread(detail::MixedWriter<Adapter>, std::ref(ht), std::cref(cfg),
+                                               std::cref(start), std::cref(stop),
+                                               std::ref(results[cfg.readers + i]), i);
+    auto t1 = clock_type::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(cfg.seconds));
+    stop.store(true);
+    for (auto &t : threads) t.join();
+
+    MixedResult ret;
+    ret.seconds = std::chrono::duration<double>(clock_type::now() - t1).count();
+    for (std::size_t i = 0; i < threadNum; i++) {
+        const auto &r = results[i];
+        if (i < cfg.readers) {
+            ret.read_latency.Merge(r.latency);
+            ret.read_ops += r.ops;
+            ret.read_misses += r.misses;
+        } else {
+            ret.write_latency.Merge(r.latency);
+            ret.write_ops += r.ops;
+        }
+    }
+    return ret;
+}
+
+inline void PrintLatency(std::ostream &os, const char *name, const LatencyHistogram &h) {
+    os << "  " << std::left << std::setw(7) << name << std::right << " count=" << h.Count()
+       << " p50=" << FormatNs(h.Percentile(50))
+       << " p99=" << FormatNs(h.Percentile(99))
+       << " p999=" << FormatNs(h.Percentile(99.9))
+       << " max=" << FormatNs(h.Max()) << "\n";
+}
+
+} // namespace bench
+
+#endif //NEATLIB_MIXED_RUNNER_H
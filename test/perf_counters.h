@@ -0,0 +1,128 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Hardware performance counters around a measured region, read through
+// perf_event_open(2). Counters the kernel or the machine refuses (no PMU in
+// a VM, perf_event_paranoid too high, not Linux) are reported as missing
+// instead of failing the benchmark.
+//
+
+#ifndef NEATLIB_PERF_COUNTERS_H
+#define NEATLIB_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+class PerfCounters {
+public:
+    enum Event {
+        kCycles = 0, kInstructions, kL1DMisses, kLLCMisses, kDTLBMisses, kBranchMisses, kEventCount
+    };
+
+    static const char *EventName(std::size_t e) {
+        static const char *names[kEventCount] = {
+                "cycles", "instructions", "L1d-miss", "LLC-miss", "dTLB-miss", "branch-miss"};
+        return names[e];
+    }
+
+    // Scaled counts of the last Start()/Stop() region; valid[e] is false when
+    // the event could not be opened or never got scheduled.
+    struct Sample {
+        std::array<double, kEventCount> value{};
+        std::array<bool, kEventCount> valid{};
+    };
+
+    PerfCounters() {
+        fds_.fill(-1);
+#ifdef __linux__
+        Open(kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        Open(kInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        Open(kL1DMisses, PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_L1D));
+        Open(kLLCMisses, PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_LL));
+        Open(kDTLBMisses, PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_DTLB));
+        Open(kBranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds_)
+            if (fd >= 0) close(fd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool Available() const {
+        for (int fd : fds_)
+            if (fd >= 0) return true;
+        return false;
+    }
+
+    void Start() {
+#ifdef __linux__
+        for (int fd : fds_) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    Sample Stop() {
+        Sample ret;
+#ifdef __linux__
+        for (int fd : fds_)
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        for (std::size_t e = 0; e < kEventCount; e++) {
+            if (fds_[e] < 0) continue;
+            // value, time enabled, time running: more events than PMU slots get
+            // multiplexed and are scaled up by enabled / running
+            uint64_t buf[3] = {0, 0, 0};
+            if (read(fds_[e], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) continue;
+            ret.value[e] = static_cast<double>(buf[0]) * static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+            ret.valid[e] = true;
+        }
+#endif
+        return ret;
+    }
+
+private:
+#ifdef __linux__
+    static uint64_t CacheConfig(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    void Open(Event e, uint32_t type, uint64_t config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds_[e] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    std::array<int, kEventCount> fds_;
+};
+
+} // namespace bench
+
+#endif //NEATLIB_PERF_COUNTERS_H
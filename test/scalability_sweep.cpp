@@ -0,0 +1,124 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Thread scalability sweep: runs every concurrent table from 1 thread up to
+// all hardware threads under each op mix and pinning policy, and writes one
+// CSV row per run.
+//
+// usage: scalability_sweep [table=concurrent:4:8,lockfree:4:8] [workload=C,B,A]
+//                          [pin=compact,scatter] [threads=<all cpus>] [steps=all|pow2]
+//                          [dist=zipfian] [records=1000000] [ops=10000000] [theta=0.99]
+//                          [csv=<file>]
+//
+// pin=compact fills both hardware threads of a core before moving to the next
+// core and socket, pin=scatter spreads threads over sockets and physical cores
+// before using SMT siblings, pin=none leaves placement to the scheduler.
+// Thread counts above the CPU count wrap around the placement order. The
+// speedup and efficiency columns are relative to the 1 thread run of the same
+// table, op mix and pinning (or to the smallest thread count, assuming it
+// scaled linearly, when the sweep does not start at 1). Without csv= the
+// rows go to stdout, progress notes go to stderr.
+//
+#include <algorithm>
+#include <fstream>
+#include <type_traits>
+#include "cpu_topology.h"
+#include "ycsb_runner.h"
+
+using namespace std;
+using namespace bench;
+
+struct SweepConfig {
+    vector<size_t> thread_counts;
+    vector<Pinning> pinnings;
+    RunConfig base;
+};
+
+template<typename Adapter>
+void sweep_table(ostream &csv, const string &tableName, const string &workload,
+                 const SweepConfig &sweep, const CpuTopology &topo) {
+    for (Pinning pin : sweep.pinnings) {
+        vector<int> order = topo.Order(pin);
+        double baseline = 0;
+        for (size_t threadNum : sweep.thread_counts) {
+            RunConfig cfg = sweep.base;
+            cfg.threads = threadNum;
+            ThreadStartHook hook;
+            if (pin != Pinning::None)
+                hook = [&order](size_t i) { CpuTopology::PinCurrentThread(order[i % order.size()]); };
+
+            Adapter ht(cfg.threads, cfg.records + cfg.ExpectedInserts());
+            RunResult r = RunWorkload(ht, cfg, hook);
+            double throughput = r.RunThroughput();
+            // the first run is the baseline, scaled as if it were perfectly linear from 1 thread
+            if (baseline == 0) baseline = throughput / threadNum;
+            double speedup = baseline > 0 ? throughput / baseline : 0;
+
+            LatencyHistogram merged;
+            for (const auto &h : r.total.latency) merged.Merge(h);
+
+            csv << tableName << "," << workload << "," << PinningName(pin) << "," << threadNum << ","
+                << fixed << setprecision(0) << throughput << ","
+                << setprecision(3) << speedup << "," << speedup / threadNum << ","
+                << merged.Percentile(50) << "," << merged.Percentile(99) << endl;
+            cerr << "# " << tableName << " " << workload << " " << PinningName(pin) << " threads="
+                 << threadNum << " " << fixed << setprecision(0) << throughput << " ops/s" << endl;
+        }
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    CpuTopology topo;
+    vector<string> tables = Split(opt.Get("table", "concurrent:4:8,lockfree:4:8"));
+    vector<string> workloads = Split(opt.Get("workload", "C,B,A"));
+
+    SweepConfig sweep;
+    for (const auto &p : Split(opt.Get("pin", "compact,scatter")))
+        sweep.pinnings.push_back(ParsePinning(p));
+    size_t maxThreads = max<size_t>(1, opt.GetSize("threads", topo.CpuCount()));
+    if (opt.Get("steps", "all") == "pow2") {
+        for (size_t n = 1; n < maxThreads; n *= 2) sweep.thread_counts.push_back(n);
+        sweep.thread_counts.push_back(maxThreads);
+    } else {
+        for (size_t n = 1; n <= maxThreads; n++) sweep.thread_counts.push_back(n);
+    }
+    sweep.base.records = max<size_t>(1, opt.GetSize("records", 1000000));
+    sweep.base.ops = opt.GetSize("ops", 10000000);
+    sweep.base.theta = opt.GetDouble("theta", 0.99);
+
+    ofstream file;
+    string csvPath = opt.Get("csv", "");
+    if (!csvPath.empty()) {
+        file.open(csvPath);
+        if (!file) {
+            cerr << "cannot open " << csvPath << endl;
+            return 1;
+        }
+    }
+    ostream &csv = csvPath.empty() ? cout : file;
+
+    cerr << "# " << topo.CpuCount() << " cpus, " << topo.CoreCount() << " cores, "
+         << topo.PackageCount() << " sockets" << endl;
+    csv << "table,workload,pinning,threads,ops_per_sec,speedup,efficiency,p50_ns,p99_ns" << endl;
+    for (const auto &w : workloads) {
+        sweep.base.workload = MakeWorkload(w);
+        if (!opt.Get("dist", "").empty())
+            sweep.base.workload.dist = ParseDistribution(opt.Get("dist", ""));
+        for (const auto &t : tables) {
+            bool found = DispatchTable(t, [&](auto *tag) {
+                using Adapter = typename remove_pointer<decltype(tag)>::type;
+                if (!Adapter::kConcurrent) {
+                    cerr << "# skipping " << t << ", it is not thread safe" << endl;
+                    return;
+                }
+                sweep_table<Adapter>(csv, t, w, sweep, topo);
+            });
+            if (!found) {
+                cerr << "unknown table: " << t << endl;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Startup cost of a BasicHashTable rebuilt from scratch against one mapped
+// from a snapshot file, and lookups on both.
+//
+// usage: snapshot_bench [table=basic:4|basic:8|basic:4:16] [n=10000000] [lookups=1000000]
+//                       [path=neatlib.snap] [mode=all|save|open]
+//
+// mode=save only builds the table and writes the snapshot, mode=open only
+// maps an existing one, so the open side can be timed in a fresh process
+// (drop the page cache in between to see a cold start).
+//
+#include <random>
+#include "bench_util.h"
+
+using namespace std;
+using namespace bench;
+
+double seconds_since(uint64_t start) {
+    return double(NowNs() - start) / 1e9;
+}
+
+// ns per lookup of random present keys, checking every value
+template<typename Table>
+double lookup_ns(const Table &ht, size_t n, size_t lookups) {
+    mt19937_64 en(42);
+    uint64_t start = NowNs();
+    size_t bad = 0;
+    for (size_t i = 0; i < lookups; i++) {
+        uint64_t rec = en() % n;
+        const uint64_t *v = ht.FindPtr(MakeKey(rec));
+        bad += v == nullptr || *v != rec;
+    }
+    double ret = double(NowNs() - start) / lookups;
+    if (bad) cout << "  " << bad << " lookups returned a wrong value" << endl;
+    return ret;
+}
+
+template<typename HT>
+void run(const string &name, const Options &opt) {
+    size_t n = max<size_t>(1, opt.GetSize("n", 10000000));
+    size_t lookups = opt.GetSize("lookups", 1000000);
+    string path = opt.Get("path", "neatlib.snap");
+    string mode = opt.Get("mode", "all");
+
+    cout << "TABLE: " << name << "  N: " << n << "  PATH: " << path << endl;
+    if (mode == "all" || mode == "save") {
+        uint64_t start = NowNs();
+        HT ht(n);
+        for (size_t i = 0; i < n; i++) ht.Insert(MakeKey(i), i);
+        cout << "  BUILD:     " << fixed << setprecision(3) << seconds_since(start) << " s" << endl;
+        cout << "  LOOKUP:    " << setprecision(1) << lookup_ns(ht, n, lookups) << " ns (live table)" << endl;
+        start = NowNs();
+        ht.SaveSnapshot(path);
+        cout << "  SAVE:      " << setprecision(3) << seconds_since(start) << " s" << endl;
+    }
+    if (mode == "all" || mode == "open") {
+        size_t rss = ResidentBytes();
+        uint64_t start = NowNs();
+        auto snap = HT::OpenSnapshot(path);
+        cout << "  OPEN:      " << fixed << setprecision(3) << seconds_since(start) * 1e3 << " ms, "
+             << snap.Bytes() / (1024 * 1024) << " MB mapped, " << snap.Size() << " entries" << endl;
+        if (snap.Size() < n) n = snap.Size();
+        if (n == 0) return;
+        start = NowNs();
+        const uint64_t *first = snap.FindPtr(MakeKey(0));
+        cout << "  FIRST GET: " << setprecision(1) << double(NowNs() - start) / 1e3 << " us"
+             << (first != nullptr && *first == 0 ? "" : " (wrong value)") << endl;
+        cout << "  LOOKUP:    " << lookup_ns(snap, n, lookups) << " ns (snapshot)" << endl;
+        cout << "  RSS:       " << showpos << SignedDelta(ResidentBytes(), rss) / (1024 * 1024) << noshowpos
+             << " MB after the lookups" << endl;
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    string table = opt.Get("table", "basic:8");
+    bool found = DispatchBasicTable(table, [&](auto *tag) {
+        run<typename remove_pointer<decltype(tag)>::type>(table, opt);
+    });
+    if (!found) {
+        cerr << "unknown table: " << table << endl;
+        return 1;
+    }
+    return 0;
+}
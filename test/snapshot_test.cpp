@@ -0,0 +1,176 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Saves BasicHashTables with SaveSnapshot(), maps them back with
+// OpenSnapshot() and compares Size() and every entry, plus keys that are
+// not there. Then checks that opening fails with std::runtime_error for a
+// truncated file, a file of another format version, a file written with
+// another hash function or for another table type, and a missing file.
+// Prints every mismatch and exits 1 if there was any.
+//
+// usage: snapshot_test [elements=100000]
+//
+
+#include "neatlib/basic_hash_table.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+size_t failures = 0;
+
+void fail(const string &what) {
+    cout << "MISMATCH: " << what << endl;
+    ++failures;
+}
+
+// std::hash of the key mixed with a seed; tables always hash with the
+// default seed, a snapshot can be opened with another one
+struct SeededHash {
+    uint64_t seed_ = 1;
+
+    size_t operator()(uint64_t key) const noexcept { return std::hash<uint64_t>()(key ^ seed_) * 0x9E3779B97F4A7C15ULL; }
+};
+
+// one full hash for every key, so all of them end up in one bucket
+struct ConstantHash {
+    size_t operator()(uint64_t) const noexcept { return 42; }
+};
+
+template<typename Hash, size_t HASH_LEVEL, typename V = uint64_t>
+using TableOf = neatlib::BasicHashTable<uint64_t, V, Hash, std::equal_to<uint64_t>,
+        std::allocator<std::pair<const uint64_t, V>>, HASH_LEVEL>;
+
+const string PATH = "snapshot_test.snap";
+
+vector<char> read_file(const string &path) {
+    ifstream in(path, ios::binary);
+    return vector<char>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void write_file(const string &path, const vector<char> &bytes) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+}
+
+// Whether opening path as a snapshot of HT throws std::runtime_error.
+template<typename HT>
+bool open_fails(const string &path, const typename HT::hasher &hash = typename HT::hasher()) {
+    try {
+        auto snap = HT::OpenSnapshot(path, hash);
+        return false;
+    } catch (const runtime_error &) {
+        return true;
+    }
+}
+
+// Fills a table with n random keys, removes every third one again so the
+// arrays go through the smaller layouts too, saves it, opens the file and
+// compares the two.
+template<typename HT>
+void round_trip(const string &name, size_t n, size_t range, uint64_t seed) {
+    HT ht;
+    unordered_map<uint64_t, uint64_t> model;
+    mt19937_64 en(seed);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = en() % range, value = en();
+        if (ht.Insert(key, value)) model.emplace(key, value);
+    }
+    for (auto it = model.begin(); it != model.end();) {
+        if (it->second % 3 == 0) {
+            ht.Remove(it->first);
+            it = model.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    ht.SaveSnapshot(PATH);
+    auto snap = HT::OpenSnapshot(PATH);
+    if (snap.Size() != model.size() || snap.Size() != ht.Size())
+        fail(name + ": Size() " + to_string(snap.Size()) + ", expected " + to_string(model.size()));
+    for (const auto &kv : model) {
+        const uint64_t *v = snap.FindPtr(kv.first);
+        if (v == nullptr || *v != kv.second || !snap.Contains(kv.first) || snap.Get(kv.first).second != kv.second) {
+            fail(name + ": entry " + to_string(kv.first) + " lost or changed");
+            return;
+        }
+    }
+    for (uint64_t key = range; key < range + 1000; key++) {
+        if (snap.FindPtr(key) != nullptr || snap.Contains(key))
+            fail(name + ": finds key " + to_string(key) + " that was never inserted");
+    }
+    for (const auto &kv : ht) {
+        if (model.find(kv.first) == model.end()) fail(name + ": table holds a removed key");
+    }
+}
+
+// Damaged and foreign files, each of which has to be refused.
+void refused() {
+    using HT = TableOf<SeededHash, 4>;
+    HT ht;
+    for (uint64_t i = 0; i < 5000; i++) ht.Insert(i, i);
+    ht.SaveSnapshot(PATH);
+    vector<char> good = read_file(PATH);
+    if (open_fails<HT>(PATH, SeededHash{})) fail("refused: the good file is refused");
+
+    if (!open_fails<HT>(PATH, SeededHash{8})) fail("refused: opened with another hash seed");
+    if (!open_fails<TableOf<std::hash<uint64_t>, 4>>(PATH)) fail("refused: opened with another hash function");
+    if (!open_fails<TableOf<SeededHash, 8>>(PATH, SeededHash{})) fail("refused: opened with another HASH_LEVEL");
+    if (!open_fails<TableOf<SeededHash, 4, uint32_t>>(PATH, SeededHash{}))
+        fail("refused: opened with another mapped type");
+
+    write_file(PATH, vector<char>(good.begin(), good.end() - 64));
+    if (!open_fails<HT>(PATH, SeededHash{})) fail("refused: opened a truncated file");
+    write_file(PATH, vector<char>(good.begin(), good.begin() + sizeof(neatlib::SnapshotHeader) / 2));
+    if (!open_fails<HT>(PATH, SeededHash{})) fail("refused: opened a file shorter than the header");
+
+    vector<char> other_version = good;
+    uint32_t version = neatlib::SnapshotHeader::kVersion + 1;
+    memcpy(&other_version[offsetof(neatlib::SnapshotHeader, version_)], &version, sizeof(version));
+    write_file(PATH, other_version);
+    if (!open_fails<HT>(PATH, SeededHash{})) fail("refused: opened a file of another version");
+
+    vector<char> no_magic = good;
+    no_magic[0] = 'X';
+    write_file(PATH, no_magic);
+    if (!open_fails<HT>(PATH, SeededHash{})) fail("refused: opened a file without the magic");
+
+    remove(PATH.c_str());
+    if (!open_fails<HT>(PATH, SeededHash{})) fail("refused: opened a missing file");
+}
+
+int main(int argc, const char *argv[]) {
+#ifdef NEATLIB_SNAPSHOT_MMAP
+    size_t n = argc >= 2 ? stoull(string(argv[1])) : 100000;
+
+    round_trip<TableOf<std::hash<uint64_t>, 4>>("default table", n, n * 2, 1);
+    round_trip<TableOf<std::hash<uint64_t>, 8>>("level 8", n, n * 2, 2);
+    round_trip<TableOf<SeededHash, 4>>("seeded hash", n, n * 2, 3);
+    round_trip<TableOf<std::hash<uint64_t>, 4>>("a few keys", 20, 40, 4);
+    round_trip<TableOf<std::hash<uint64_t>, 4>>("empty table", 0, 1, 5);
+    round_trip<TableOf<ConstantHash, 4>>("colliding keys", 500, 1000, 6);
+    refused();
+    remove(PATH.c_str());
+
+    if (failures != 0) {
+        cout << failures << " MISMATCHES" << endl;
+        return 1;
+    }
+    cout << "OK" << endl;
+#else
+    (void) argc;
+    (void) argv;
+    cout << "snapshots are not supported here, nothing to check" << endl;
+#endif
+    return 0;
+}
@@ -0,0 +1,158 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Reclamation while a reader sits inside the epoch: writers update at full
+// speed, and for a while one or more threads enter the table's epoch and
+// stall there, as a preempted or slow reader would.
+//
+// usage: stalled_reader_bench [table=lockfree-counters:4:8] [writers=4] [stalled=1]
+//                             [stall=sleep|spin] [stall_at=1] [stall_for=2]
+//                             [seconds=5] [interval=0.1] [records=1000000]
+//
+// The stalled threads enter at stall_at seconds and leave stall_for seconds
+// later. Every interval the main thread prints one row: writer throughput in
+// that interval, DataNodes retired but not yet reclaimed, drain list
+// occupancy, reclaim lag in epochs, slowdown sleeps and the process RSS.
+//
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include "bench_util.h"
+
+using namespace std;
+using namespace bench;
+
+// only the lock free tables can hold their epoch open
+template<typename HT>
+auto enter_epoch(HT &ht, int) -> decltype(ht.EnterEpoch(), bool()) {
+    ht.EnterEpoch();
+    return true;
+}
+
+template<typename HT>
+bool enter_epoch(HT &, long) { return false; }
+
+template<typename HT>
+auto leave_epoch(HT &ht, int) -> decltype(ht.LeaveEpoch(), void()) { ht.LeaveEpoch(); }
+
+template<typename HT>
+void leave_epoch(HT &, long) {}
+
+template<typename HT>
+auto telemetry(HT &ht, int) -> decltype(ht.GetEpochTelemetry()) { return ht.GetEpochTelemetry(); }
+
+template<typename HT>
+FASTER::core::EpochTelemetry telemetry(HT &, long) { return FASTER::core::EpochTelemetry(); }
+
+struct StallConfig {
+    size_t writers;
+    size_t stalled;
+    bool spin;
+    double stall_at;
+    double stall_for;
+    double seconds;
+    double interval;
+    size_t records;
+};
+
+template<typename Adapter>
+void writer_task(Adapter &ht, const StallConfig &cfg, const atomic<bool> &stop,
+                 atomic<uint64_t> &ops, size_t threadIdx) {
+    default_random_engine en(static_cast<unsigned int>(threadIdx * 7919 + 1));
+    uniform_int_distribution<uint64_t> dis(0, cfg.records - 1);
+    uint64_t n = 0;
+    while (!stop.load(memory_order_relaxed)) {
+        ht.Update(Fnv64(dis(en)), n);
+        ops.store(++n, memory_order_relaxed);
+    }
+}
+
+template<typename Adapter>
+void stalled_task(Adapter &ht, const StallConfig &cfg, clock_type::time_point begin) {
+    this_thread::sleep_until(begin + chrono::duration_cast<clock_type::duration>(
+            chrono::duration<double>(cfg.stall_at)));
+    auto until = clock_type::now() + chrono::duration_cast<clock_type::duration>(
+            chrono::duration<double>(cfg.stall_for));
+    enter_epoch(ht.Table(), 0);
+    if (cfg.spin) {
+        while (clock_type::now() < until) {}
+    } else {
+        this_thread::sleep_until(until);
+    }
+    leave_epoch(ht.Table(), 0);
+}
+
+template<typename Adapter>
+void run(const string &tableName, const StallConfig &cfg) {
+    Adapter ht(cfg.writers + cfg.stalled, cfg.records);
+    if (!enter_epoch(ht.Table(), 0)) {
+        cerr << tableName << " has no epoch to stall" << endl;
+        return;
+    }
+    leave_epoch(ht.Table(), 0);
+    for (uint64_t i = 0; i < cfg.records; i++) ht.Insert(Fnv64(i), i);
+
+    cout << "TABLE: " << tableName << "  WRITERS: " << cfg.writers << "  STALLED: " << cfg.stalled
+         << " (" << (cfg.spin ? "spin" : "sleep") << " from " << cfg.stall_at << "s for "
+         << cfg.stall_for << "s)  RECORDS: " << cfg.records << endl;
+    cout << setw(8) << "TIME(s)" << setw(14) << "WRITES/s" << setw(12) << "UNRECLAIMED"
+         << setw(10) << "DRAIN" << setw(10) << "LAG" << setw(11) << "SLOWDOWNS" << setw(10) << "RSS(MB)"
+         << endl;
+
+    atomic<bool> stop(false);
+    vector<atomic<uint64_t>> ops(cfg.writers);
+    for (auto &o : ops) o.store(0);
+    vector<thread> threads;
+    auto begin = clock_type::now();
+    for (size_t i = 0; i < cfg.writers; i++)
+        threads.emplace_back(writer_task<Adapter>, std::ref(ht), std::cref(cfg), std::cref(stop),
+                             std::ref(ops[i]), i);
+    for (size_t i = 0; i < cfg.stalled; i++)
+        threads.emplace_back(stalled_task<Adapter>, std::ref(ht), std::cref(cfg), begin);
+
+    uint64_t lastOps = 0;
+    auto last = begin;
+    auto step = chrono::duration_cast<clock_type::duration>(chrono::duration<double>(cfg.interval));
+    for (auto next = begin + step; next - begin <= chrono::duration<double>(cfg.seconds); next += step) {
+        this_thread::sleep_until(next);
+        auto now = clock_type::now();
+        uint64_t total = 0;
+        for (const auto &o : ops) total += o.load(memory_order_relaxed);
+        FASTER::core::EpochTelemetry t = telemetry(ht.Table(), 0);
+        double elapsed = chrono::duration<double>(now - last).count();
+        cout << fixed << setprecision(2) << setw(8) << chrono::duration<double>(now - begin).count()
+             << setprecision(0) << setw(14) << (total - lastOps) / elapsed
+             << setw(12) << t.retired - t.reclaimed
+             << setw(10) << t.pending_drain_actions << setw(10) << t.reclaim_lag
+             << setw(11) << t.slowdown_events
+             << setprecision(1) << setw(10) << ResidentBytes() / (1024.0 * 1024.0) << endl;
+        lastOps = total;
+        last = now;
+    }
+    stop.store(true);
+    for (auto &t : threads) t.join();
+    ht.Report(cout);
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    string table = opt.Get("table", "lockfree-counters:4:8");
+    StallConfig cfg;
+    cfg.writers = max<size_t>(1, opt.GetSize("writers", 4));
+    cfg.stalled = opt.GetSize("stalled", 1);
+    cfg.spin = opt.Get("stall", "sleep") == "spin";
+    cfg.stall_at = opt.GetDouble("stall_at", 1);
+    cfg.stall_for = opt.GetDouble("stall_for", 2);
+    cfg.seconds = opt.GetDouble("seconds", 5);
+    cfg.interval = max(0.001, opt.GetDouble("interval", 0.1));
+    cfg.records = max<size_t>(1, opt.GetSize("records", 1000000));
+
+    bool found = DispatchTable(table, [&](auto *tag) {
+        run<typename remove_pointer<decltype(tag)>::type>(table, cfg);
+    });
+    if (!found) {
+        cerr << "unknown table: " << table << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// Node memory from the general heap against a HugePageArena in each of its
+// modes, for BasicHashTable and LockFreeHashTable: load and lookup time,
+// dTLB misses per lookup (where perf counters can be read) and how much of
+// the node memory ended up on huge pages.
+//
+// usage: tlb_bench [table=basic:4,lockfree:4:8] [backend=heap,off,thp,auto]
+//                  [n=4000000] [lookups=2000000]
+//
+// backend=off is the arena on 4 KB pages (MADV_NOHUGEPAGE), thp asks for
+// transparent huge pages with MADV_HUGEPAGE, auto tries MAP_HUGETLB first
+// (reserve some with /proc/sys/vm/nr_hugepages) and falls back to thp.
+//
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include "bench_util.h"
+#include "perf_counters.h"
+#include "neatlib/huge_page_arena.h"
+
+using namespace std;
+using namespace bench;
+
+using ArenaAlloc = neatlib::HugePageAllocator<std::pair<const uint64_t, uint64_t>>;
+using HeapAlloc = std::allocator<std::pair<const uint64_t, uint64_t>>;
+
+template<typename Alloc>
+using Basic4 = neatlib::BasicHashTable<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Alloc, 4>;
+
+template<typename Alloc>
+using LockFree48 = neatlib::LockFreeHashTable<uint64_t, uint64_t, std::hash<uint64_t>, 4, 8,
+        neatlib::instrumentation::None, Alloc>;
+
+// AnonHugePages of the process in bytes, 0 where it cannot be read
+size_t anon_huge_bytes() {
+    size_t ret = 0;
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (f == nullptr) return 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long kb = 0;
+        if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) ret = kb * 1024;
+    }
+    fclose(f);
+#endif
+    return ret;
+}
+
+// keeps the Get loop from being optimized away
+volatile uint64_t g_sink = 0;
+
+template<typename Alloc>
+size_t hugetlb_bytes(const Alloc &) { return 0; }
+
+size_t hugetlb_bytes(const ArenaAlloc &alloc) { return alloc.Arena().HugeTlbBytes(); }
+
+// the tables are neither copyable nor movable
+template<typename Alloc>
+unique_ptr<Basic4<Alloc>> make_table(Basic4<Alloc> *, size_t n, const Alloc &alloc) {
+    return unique_ptr<Basic4<Alloc>>(new Basic4<Alloc>(n, alloc));
+}
+
+template<typename Alloc>
+unique_ptr<LockFree48<Alloc>> make_table(LockFree48<Alloc> *, size_t n, const Alloc &alloc) {
+    // one thread, the main one, with all n data nodes pooled up front
+    return unique_ptr<LockFree48<Alloc>>(new LockFree48<Alloc>(1, n, alloc));
+}
+
+template<typename HT, typename Alloc>
+void run(const string &table, const string &backend, const Alloc &alloc, size_t n, size_t lookups) {
+    size_t huge_before = anon_huge_bytes();
+    size_t rss_before = ResidentBytes();
+    unique_ptr<HT> table_ptr = make_table(static_cast<HT *>(nullptr), n, alloc);
+    HT &ht = *table_ptr;
+
+    uint64_t start = NowNs();
+    for (size_t i = 0; i < n; i++) ht.Insert(MakeKey(i), i);
+    double insert_ns = double(NowNs() - start) / n;
+
+    mt19937_64 en(11);
+    vector<uint64_t> probe(lookups);
+    for (auto &k : probe) k = MakeKey(en() % n);
+    PerfCounters counters;
+    counters.Start();
+    start = NowNs();
+    uint64_t sink = 0;
+    for (uint64_t k : probe) sink += ht.Get(k).second;
+    double find_ns = double(NowNs() - start) / lookups;
+    PerfCounters::Sample sample = counters.Stop();
+    g_sink = sink;
+
+    int64_t huge = SignedDelta(anon_huge_bytes(), huge_before) + static_cast<int64_t>(hugetlb_bytes(alloc));
+    int64_t rss = SignedDelta(ResidentBytes(), rss_before);
+    cout << "  " << left << setw(14) << table << setw(8) << backend << right << fixed << setprecision(1)
+         << setw(10) << insert_ns << setw(10) << find_ns;
+    if (sample.valid[PerfCounters::kDTLBMisses])
+        cout << setw(12) << setprecision(3) << sample.value[PerfCounters::kDTLBMisses] / lookups;
+    else
+        cout << setw(12) << "n/a";
+    cout << setw(10) << rss / (1024 * 1024) << setw(10) << huge / (1024 * 1024) << endl;
+}
+
+template<template<typename> class HT>
+void run_backend(const string &table, const string &backend, size_t n, size_t lookups) {
+    if (backend == "heap") run<HT<HeapAlloc>>(table, backend, HeapAlloc(), n, lookups);
+    else if (backend == "off") run<HT<ArenaAlloc>>(table, backend, ArenaAlloc(neatlib::HugePages::Off), n, lookups);
+    else if (backend == "thp") run<HT<ArenaAlloc>>(table, backend, ArenaAlloc(neatlib::HugePages::Transparent), n, lookups);
+    else if (backend == "auto") run<HT<ArenaAlloc>>(table, backend, ArenaAlloc(neatlib::HugePages::Auto), n, lookups);
+    else cerr << "unknown backend: " << backend << endl;
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    size_t n = max<size_t>(1, opt.GetSize("n", 4000000));
+    size_t lookups = max<size_t>(1, opt.GetSize("lookups", 2000000));
+    vector<string> tables = Split(opt.Get("table", "basic:4,lockfree:4:8"));
+    vector<string> backends = Split(opt.Get("backend", "heap,off,thp,auto"));
+
+    cout << "NODE MEMORY BACKENDS: n=" << n << " lookups=" << lookups << endl;
+    cout << "  " << left << setw(14) << "TABLE" << setw(8) << "MEMORY" << right << setw(10) << "INS ns"
+         << setw(10) << "GET ns" << setw(12) << "dTLB/GET" << setw(10) << "RSS MB" << setw(10) << "HUGE MB" << endl;
+    for (const string &table : tables) {
+        for (const string &backend : backends) {
+            if (table == "basic:4") run_backend<Basic4>(table, backend, n, lookups);
+            else if (table == "lockfree:4:8") run_backend<LockFree48>(table, backend, n, lookups);
+            else cerr << "unknown table: " << table << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// YCSB-style mixed workloads against every hash table behind one adapter.
+//
+// usage: ycsb_bench [table=lockfree:4:8|...|all] [workload=A..F|custom|all]
+//                   [dist=uniform|zipfian|latest|sequential] [threads=12]
+//                   [records=1000000] [ops=10000000] [theta=0.99] [ordered=0] [stats=0]
+//                   [read=..] [update=..] [insert=..] [remove=..] [scan=..] [rmw=..]
+//
+// The percentages are only used by workload=custom.
+//
+#include <algorithm>
+#include <type_traits>
+#include "ycsb_runner.h"
+
+using namespace std;
+using namespace bench;
+
+template<typename Adapter>
+void run_workload(const string &tableName, RunConfig cfg) {
+    if (!Adapter::kConcurrent && cfg.threads > 1) {
+        cout << "# " << tableName << " is not thread safe, running with 1 thread" << endl;
+        cfg.threads = 1;
+    }
+    Adapter ht(cfg.threads, cfg.records + cfg.ExpectedInserts());
+    RunResult r = RunWorkload(ht, cfg);
+
+    cout << "TABLE: " << tableName << "  WORKLOAD: " << cfg.workload.name
+         << "  THREADS: " << cfg.threads << "  RECORDS: " << cfg.records << endl;
+    cout << "  LOAD:    " << fixed << setprecision(0) << r.LoadThroughput(cfg.records) << " ops/s" << endl;
+    cout << "  RUN:     " << r.RunThroughput() << " ops/s (" << setprecision(3) << r.run_seconds << " s)" << endl;
+    for (size_t op = 0; op < kOpTypeCount; op++) {
+        const LatencyHistogram &h = r.total.latency[op];
+        if (h.Count() == 0) continue;
+        cout << "  " << left << setw(7) << OpName(op) << right
+             << " count=" << h.Count()
+             << " failed=" << r.total.failed[op]
+             << " p50=" << FormatNs(h.Percentile(50))
+             << " p99=" << FormatNs(h.Percentile(99))
+             << " p999=" << FormatNs(h.Percentile(99.9))
+             << " max=" << FormatNs(h.Max()) << endl;
+    }
+    ht.Report(cout);
+    if (cfg.stats) ht.Stats().Dump(cout);
+}
+
+int main(int argc, const char *argv[]) {
+    Options opt(argc, argv);
+    string tableOpt = opt.Get("table", "lockfree:4:8");
+    string workloadOpt = opt.Get("workload", "A");
+
+    vector<string> tables = tableOpt == "all" ? TableNames() : vector<string>{tableOpt};
+    vector<string> workloads = workloadOpt == "all" ?
+                               vector<string>{"A", "B", "C", "D", "E", "F"} : vector<string>{workloadOpt};
+
+    for (const auto &w : workloads) {
+        RunConfig cfg;
+        if (w == "custom") {
+            cfg.workload.name = "custom";
+            cfg.workload.proportion[kRead] = opt.GetDouble("read", 0);
+            cfg.workload.proportion[kUpdate] = opt.GetDouble("update", 0);
+            cfg.workload.proportion[kInsert] = opt.GetDouble("insert", 0);
+            cfg.workload.proportion[kRemove] = opt.GetDouble("remove", 0);
+            cfg.workload.proportion[kScan] = opt.GetDouble("scan", 0);
+            cfg.workload.proportion[kReadModifyWrite] = opt.GetDouble("rmw", 0);
+        } else {
+            cfg.workload = MakeWorkload(w);
+        }
+        if (!opt.Get("dist", "").empty())
+            cfg.workload.dist = ParseDistribution(opt.Get("dist", ""));
+        cfg.workload.scan_length = opt.GetSize("scanlen", cfg.workload.scan_length);
+        cfg.threads = max<size_t>(1, opt.GetSize("threads", 12));
+        cfg.records = max<size_t>(1, opt.GetSize("records", 1000000));
+        cfg.ops = opt.GetSize("ops", 10000000);
+        cfg.theta = opt.GetDouble("theta", 0.99);
+        cfg.ordered = opt.GetSize("ordered", 0) != 0;
+        cfg.stats = opt.GetSize("stats", 0) != 0;
+
+        for (const auto &t : tables) {
+            bool found = DispatchTable(t, [&](auto *tag) {
+                run_workload<typename remove_pointer<decltype(tag)>::type>(t, cfg);
+            });
+            if (!found) {
+                cerr << "unknown table: " << t << endl;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+//
+// Created by jiahua on 2026/10/17.
+//
+// The load and run phases of a YCSB-style workload over any bench adapter,
+// shared by ycsb_bench and scalability_sweep.
+//
+
+#ifndef NEATLIB_YCSB_RUNNER_H
+#define NEATLIB_YCSB_RUNNER_H
+
+#include <functional>
+#include <thread>
+#include "bench_util.h"
+
+namespace bench {
+
+struct RunConfig {
+    Workload workload;
+    std::size_t threads = 1;
+    std::size_t records = 0;
+    std::size_t ops = 0;
+    double theta = 0.99;
+    bool ordered = false;
+    bool stats = false;
+
+    // how many records the run phase adds, so adapters can be sized up front
+    std::size_t ExpectedInserts() const {
+        return static_cast<std::size_t>(ops * (workload.proportion[kInsert] / 100.0));
+    }
+};
+
+struct ThreadResult {
+    LatencyHistogram latency[kOpTypeCount];
+    uint64_t failed[kOpTypeCount] = {0, 0, 0, 0, 0, 0};
+
+    void Merge(const ThreadResult &other) {
+        for (std::size_t op = 0; op < kOpTypeCount; op++) {
+            latency[op].Merge(other.latency[op]);
+            failed[op] += other.failed[op];
+        }
+    }
+
+    uint64_t Ops() const {
+        uint64_t ret = 0;
+        for (const auto &h : latency) ret += h.Count();
+        return ret;
+    }
+};
+
+struct RunResult {
+    ThreadResult total;
+    double load_seconds = 0;
+    double run_seconds = 0;
+
+    double LoadThroughput(std::size_t records) const { return load_seconds > 0 ? records / load_seconds : 0; }
+
+    double RunThroughput() const { return run_seconds > 0 ? total.Ops() / run_seconds : 0; }
+};
+
+// Called first thing on every worker thread with its index, e.g. to pin it.
+using ThreadStartHook = std::function<void(std::size_t)>;
+
+template<typename Adapter>
+void LoadTask(Adapter &ht, const RunConfig &cfg, std::size_t threadIdx, std::size_t threadNum) {
+    for (uint64_t i = threadIdx; i < cfg.records; i += threadNum) {
+        uint64_t key = cfg.ordered ? i : Fnv64(i);
+        ht.Insert(key, i);
+    }
+}
+
+template<typename Adapter>
+void RunTask(Adapter &ht, const RunConfig &cfg, const ZipfianGenerator &zipf,
+             std::atomic<uint64_t> &recordCount, std::atomic<uint64_t> &insertNext,
+             ThreadResult &result, std::size_t threadIdx, std::size_t threadNum) {
+    KeyChooser chooser(cfg.workload.dist, zipf, recordCount, threadIdx + 1);
+    std::uniform_real_distribution<double> pick(0.0, 1.0);
+    auto keyOf = [&cfg](uint64_t rec) { return cfg.ordered ? rec : Fnv64(rec); };
+    std::size_t ops = cfg.ops / threadNum;
+
+    for (std::size_t n = 0; n < ops; n++) {
+        OpType op = cfg.workload.Pick(pick(chooser.Engine()));
+        uint64_t value = 0;
+        bool ok = true;
+        uint64_t t1 = NowNs();
+        switch (op) {
+            case kRead:
+                ok = ht.Read(keyOf(chooser.Next()), value);
+                break;
+            case kUpdate:
+                ok = ht.Update(keyOf(chooser.Next()), n);
+                break;
+            case kInsert: {
+                uint64_t rec = insertNext.fetch_add(1, std::memory_order_relaxed);
+                ok = ht.Insert(keyOf(rec), rec);
+                recordCount.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            case kRemove:
+                ok = ht.Remove(keyOf(chooser.Next()));
+                break;
+            case kScan: {
+                uint64_t start = chooser.Next();
+                uint64_t limit = recordCount.load(std::memory_order_relaxed);
+                for (uint64_t i = 0; i < cfg.workload.scan_length && start + i < limit; i++)
+                    ok &= ht.Read(keyOf(start + i), value);
+                break;
+            }
+            case kReadModifyWrite: {
+                uint64_t key = keyOf(chooser.Next());
+                ok = ht.Read(key, value) && ht.Update(key, value + 1);
+                break;
+            }
+            default:
+                break;
+        }
+        result.latency[op].Record(NowNs() - t1);
+        if (!ok) ++result.failed[op];
+    }
+}
+
+// Loads cfg.records keys and runs cfg.ops operations of the workload, both
+// phases split over cfg.threads threads. ht must be freshly constructed.
+template<typename Adapter>
+RunResult RunWorkload(Adapter &ht, const RunConfig &cfg, const ThreadStartHook &onStart = ThreadStartHook()) {
+    RunResult ret;
+    std::vector<std::thread> threads(cfg.threads);
+
+    auto t1 = clock_type::now();
+    for (std::size_t i = 0; i < cfg.threads; i++)
+        threads[i] = std::thread([&, i] {
+            if (onStart) onStart(i);
+            LoadTask(ht, cfg, i, cfg.threads);
+        });
+    for (auto &t : threads) t.join();
+    ret.load_seconds = std::chrono::duration<double>(clock_type::now() - t1).count();
+
+    ZipfianGenerator zipf(cfg.records, cfg.theta);
+    std::atomic<uint64_t> recordCount(cfg.records), insertNext(cfg.records);
+    std::vector<ThreadResult> results(cfg.threads);
+    auto t2 = clock_type::now();
+    for (std::size_t i = 0; i < cfg.threads; i++)
+        threads[i] = std::thread([&, i] {
+            if (onStart) onStart(i);
+            RunTask(ht, cfg, zipf, recordCount, insertNext, results[i], i, cfg.threads);
+        });
+    for (auto &t : threads) t.join();
+    ret.run_seconds = std::chrono::duration<double>(clock_type::now() - t2).count();
+
+    for (const auto &r : results) ret.total.Merge(r);
+    return ret;
+}
+
+} // namespace bench
+
+#endif //NEATLIB_YCSB_RUNNER_H
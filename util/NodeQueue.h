@@ -4,12 +4,13 @@
 
 #ifndef NODELIST_NODEQUEUE_H
 #define NODELIST_NODEQUEUE_H
+#include <atomic>
 #include <cstdlib>
 
 template <typename NODE>
 class NodeQueue {
 public:
-    NodeQueue(): head_(nullptr), tail_(nullptr) {}
+    NodeQueue(): head_(nullptr), tail_(nullptr), size_(0) {}
 
     ~NodeQueue() {
         NODE *curr = head_;
@@ -23,6 +24,11 @@ public:
         return head_ == nullptr;
     }
 
+    // only the owning thread modifies the queue, other threads may read the size
+    size_t Size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
     void Push(NODE *node) {
         node->next = head_;
         node->last = nullptr;
@@ -33,6 +39,7 @@ public:
             tail_->next = nullptr;
         }
         head_ = node;
+        size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     }
 
     NODE *Pop() {
@@ -42,11 +49,13 @@ public:
             head_ = nullptr;
         else
             tail_->next = nullptr;
+        size_.store(size_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
         return ret;
     }
 private:
     NODE *head_;
     NODE *tail_;
+    std::atomic<size_t> size_;
 };
 
 #endif //NODELIST_NODEQUEUE_H